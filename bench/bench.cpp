@@ -0,0 +1,324 @@
+#include "bench.h"
+#include "corpus.h"
+#include "cpplox.h"
+#include "lox_string.h"
+#include "number.h"
+#include "scanner.h"
+#include "scheduler.h"
+#include "token.h"
+#include "token_pipeline.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+const char *msg =
+    "Usage: %s [--filter=substring] [--min-time=seconds] [--max-size=bytes] "
+    "[--json]\n"
+    "  --json  print Google Benchmark compatible JSON on stdout\n";
+
+struct Size {
+  const char *name;
+  std::size_t bytes;
+};
+const Size sizes[] = {
+    {"1KB", 1024}, {"1MB", 1024 * 1024}, {"100MB", 100 * 1024 * 1024}};
+
+template <class S = Scanner>
+std::uint64_t scan_all(const char *data, std::size_t size) {
+  S sc(data, size);
+  std::uint64_t n = 0;
+  // take_token() keeps no history, so 100MB inputs do not need gigabytes
+  while (sc.take_token().getType() != tok_eof) {
+    n++;
+  }
+  return n;
+}
+template <class S = Scanner> std::uint64_t scan_all(const std::string &src) {
+  return scan_all<S>(src.c_str(), src.size());
+}
+
+void bench_next_char(Bench &b, const Size &size) {
+  std::string file = std::string("File::next_char/") + size.name;
+  std::string memory = std::string("MemoryInput::next_char/") + size.name;
+  if (!b.matches(file) && !b.matches(memory)) {
+    return;
+  }
+  std::string src = Corpus::generate(Corpus::MIXED, size.bytes);
+  b.run(file, src.size(), [&] {
+    File f(src.data(), src.size());
+    std::uint64_t n = 0;
+    while (f.next_char() != EOF) {
+      n++;
+    }
+    return n;
+  });
+  b.run(memory, src.size(), [&] {
+    MemoryInput in(src.c_str(), src.size());
+    std::uint64_t n = 0;
+    while (in.next_char() != EOF) {
+      n++;
+    }
+    return n;
+  });
+}
+
+void bench_next_token(Bench &b, Corpus::Kind kind, const Size &size) {
+  std::string suffix =
+      std::string("/") + Corpus::kind_name(kind) + "/" + size.name;
+  std::string file = "Scanner::next_token" + suffix;
+  std::string memory = "MemoryScanner::next_token" + suffix;
+  if (!b.matches(file) && !b.matches(memory)) {
+    return;
+  }
+  std::string src = Corpus::generate(kind, size.bytes);
+  b.run(file, src.size(), [&] { return scan_all(src); });
+  b.run(memory, src.size(), [&] { return scan_all<MemoryScanner>(src); });
+}
+
+void bench_keyword_lookup(Bench &b) {
+  // half keywords, half identifiers that look like them
+  std::vector<std::string> words = {
+      "and",  "class",  "else",  "false", "func", "for",   "if",
+      "nil",  "or",     "return", "super", "this", "true",  "var",
+      "while", "list",  "print", "andy",  "classy", "elsewhere", "f",
+      "fo",   "iff",    "nill",  "order", "ret",  "sup",   "these",
+      "truth", "vars",  "whilst", "lists"};
+  b.run("keyword_type", 0, [&] {
+    std::uint64_t n = 0;
+    for (int i = 0; i < 1000; i++) {
+      for (const std::string &w : words) {
+        n += keyword_type(w) != tok_ident;
+      }
+    }
+    return n;
+  });
+}
+
+void bench_number_parse(Bench &b) {
+  // the literals of a number heavy file, parsed again the way a later
+  // phase would have to without Token::getNumber()
+  if (!b.matches("NumberLiteral::parse") && !b.matches("strtod")) {
+    return;
+  }
+  std::string src = Corpus::generate(Corpus::NUMBER, 64 * 1024);
+  std::vector<std::string> literals;
+  std::size_t bytes = 0;
+  Scanner sc(src.data(), src.size());
+  sc.scan([&](Token &t) {
+    if (t.getType() == tok_number) {
+      bytes += t.getLexeme().size();
+      literals.push_back(t.getLexeme());
+    }
+    return true;
+  });
+
+  b.run("NumberLiteral::parse", bytes, [&] {
+    double sum = 0;
+    for (const std::string &l : literals) {
+      sum += NumberLiteral::parse(l);
+    }
+    return literals.size() + (sum < 0);
+  });
+  b.run("strtod", bytes, [&] {
+    double sum = 0;
+    for (const std::string &l : literals) {
+      sum += strtod(l.c_str(), nullptr);
+    }
+    return literals.size() + (sum < 0);
+  });
+}
+
+void bench_string_concat(Bench &b) {
+  // `s = s + "x"` in a loop. Flat immutable strings copy s every time,
+  // so only small sizes are affordable for them.
+  for (std::size_t n : {64 * 1024, 256 * 1024}) {
+    b.run("std::string/concat/" + std::to_string(n / 1024) + "KB", n, [&] {
+      std::string s;
+      const std::string x = "x";
+      for (std::size_t i = 0; i < n; i++) {
+        s = s + x;
+      }
+      return s.size();
+    });
+  }
+  for (std::size_t n : {1024 * 1024, 10 * 1024 * 1024}) {
+    b.run("LoxString/concat/" + std::to_string(n / (1024 * 1024)) + "MB", n,
+          [&] {
+            LoxString s;
+            const LoxString x("x");
+            for (std::size_t i = 0; i < n; i++) {
+              s = s + x;
+            }
+            // and one flatten, as the first index or hash would
+            return s.size() + (s.hash() == 0);
+          });
+  }
+}
+
+void bench_context(Bench &b) {
+  // per request cost of an embedded script: a fresh Scanner every time
+  // against a LoxContext that keeps its buffers
+  if (!b.matches("Scanner/request/1KB") &&
+      !b.matches("LoxContext::lex/request/1KB")) {
+    return;
+  }
+  std::string src = Corpus::generate(Corpus::MIXED, 1024);
+  b.run("Scanner/request/1KB", src.size(), [&] {
+    Scanner sc(src.data(), src.size());
+    while (sc.next_token().getType() != tok_eof) {
+    }
+    return sc.get_tokens().size();
+  });
+  LoxContext ctx;
+  b.run("LoxContext::lex/request/1KB", src.size(), [&] {
+    ctx.lex(src);
+    return ctx.get_tokens().size();
+  });
+}
+
+void bench_parallel_scan(Bench &b, const Size &size) {
+  // Independent chunks (whole lines) scanned on the work-stealing pool, the
+  // shape of per-declaration work on a file with thousands of functions
+  std::vector<std::size_t> thread_counts;
+  std::size_t cores = std::max(1u, std::thread::hardware_concurrency());
+  for (std::size_t threads = 1; threads <= cores; threads *= 2) {
+    std::string name = "TaskScheduler::parallel_for/scan/" +
+                       std::string(size.name) +
+                       "/threads:" + std::to_string(threads);
+    if (b.matches(name)) {
+      thread_counts.push_back(threads);
+    }
+  }
+  if (thread_counts.empty()) {
+    return;
+  }
+
+  std::string src = Corpus::generate(Corpus::MIXED, size.bytes);
+  std::vector<std::pair<std::size_t, std::size_t>> chunks;
+  const std::size_t chunk = 64 * 1024;
+  for (std::size_t start = 0; start < src.size();) {
+    std::size_t end = std::min(src.size(), start + chunk);
+    while (end < src.size() && src[end - 1] != '\n') {
+      end++;
+    }
+    chunks.push_back({start, end});
+    start = end;
+  }
+
+  for (std::size_t threads : thread_counts) {
+    TaskScheduler pool(threads);
+    std::vector<std::uint64_t> counts(chunks.size());
+    b.run("TaskScheduler::parallel_for/scan/" + std::string(size.name) +
+              "/threads:" + std::to_string(threads),
+          src.size(), [&] {
+            // in place, copying every chunk would be timed as well
+            pool.parallel_for(chunks.size(), [&](std::size_t i) {
+              counts[i] = scan_all(src.data() + chunks[i].first,
+                                   chunks[i].second - chunks[i].first);
+            });
+            std::uint64_t n = 0;
+            for (std::uint64_t c : counts) {
+              n += c;
+            }
+            return n;
+          });
+  }
+}
+
+void bench_token_pipeline(Bench &b, const Size &size) {
+  // A file's tokens consumed on this thread, scanned here or by a
+  // TokenPipeline on a thread of its own. Only with a second core is there
+  // anything to overlap.
+  std::string scanner = std::string("Scanner::take_token/file/") + size.name;
+  std::string pipelined =
+      std::string("TokenPipeline::next_token/file/") + size.name;
+  if (!b.matches(scanner) && !b.matches(pipelined)) {
+    return;
+  }
+  std::string src = Corpus::generate(Corpus::MIXED, size.bytes);
+  char path[] = "/tmp/cpplox_bench_XXXXXX";
+  int fd = mkstemp(path);
+  if (fd == -1 || write(fd, src.data(), src.size()) != ssize_t(src.size())) {
+    fprintf(stderr, "Unable to write %s\n", path);
+    exit(EXIT_FAILURE);
+  }
+  close(fd);
+
+  b.run(scanner, src.size(), [&] {
+    Scanner sc(path);
+    std::uint64_t n = 0;
+    while (sc.take_token().getType() != tok_eof) {
+      n++;
+    }
+    return n;
+  });
+  b.run(pipelined, src.size(), [&] {
+    TokenPipeline pipeline(path);
+    std::uint64_t n = 0;
+    while (pipeline.next_token().getType() != tok_eof) {
+      n++;
+    }
+    return n;
+  });
+  unlink(path);
+}
+} // namespace
+
+int main(int argc, const char **argv) {
+  std::string filter;
+  double min_time = 0.5;
+  std::size_t max_size = ~std::size_t(0);
+  bool json = false;
+
+  for (int i = 1; i < argc; i++) {
+    if (strncmp(argv[i], "--filter=", 9) == 0) {
+      filter = argv[i] + 9;
+    } else if (strncmp(argv[i], "--min-time=", 11) == 0) {
+      min_time = atof(argv[i] + 11);
+    } else if (strncmp(argv[i], "--max-size=", 11) == 0) {
+      max_size = strtoull(argv[i] + 11, nullptr, 10);
+    } else if (strcmp(argv[i], "--json") == 0) {
+      json = true;
+    } else {
+      fprintf(stderr, msg, argv[0]);
+      return strcmp(argv[i], "--help") == 0 ? 0 : 1;
+    }
+  }
+
+  Bench b(filter, min_time);
+  const Corpus::Kind kinds[] = {Corpus::MIXED,   Corpus::IDENT,
+                                Corpus::KEYWORD, Corpus::NUMBER,
+                                Corpus::STRING,  Corpus::PUNCT};
+
+  for (const Size &size : sizes) {
+    if (size.bytes > max_size) {
+      continue;
+    }
+    bench_next_char(b, size);
+    for (Corpus::Kind kind : kinds) {
+      bench_next_token(b, kind, size);
+    }
+  }
+  bench_keyword_lookup(b);
+  bench_number_parse(b);
+  bench_string_concat(b);
+  bench_context(b);
+  for (const Size &size : sizes) {
+    if (size.bytes > max_size || size.bytes < 1024 * 1024) {
+      continue;
+    }
+    bench_parallel_scan(b, size);
+    bench_token_pipeline(b, size);
+  }
+
+  if (json) {
+    b.write_json(stdout);
+  }
+  return 0;
+}
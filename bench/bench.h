@@ -0,0 +1,95 @@
+#pragma once
+#ifndef __BENCH_H__
+#define __BENCH_H__
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Minimal Google Benchmark style harness: every benchmark body is run until
+// it has taken at least min_time, and the results are printed as a table or
+// as Google Benchmark compatible JSON.
+class Bench {
+public:
+  struct Result {
+    std::string name;
+    std::uint64_t iterations;
+    // per iteration
+    double ns, cpu_ns;
+    std::uint64_t bytes, items;
+  };
+
+private:
+  std::string filter;
+  double min_time;
+  std::vector<Result> results;
+
+public:
+  inline Bench(const std::string &filter, double min_time)
+      : filter(filter), min_time(min_time) {}
+
+  // Whether run() would run a benchmark of this name, so that input for
+  // benchmarks filtered out is never built
+  inline bool matches(const std::string &name) const {
+    return name.find(this->filter) != std::string::npos;
+  }
+
+  // Run body (which returns how many items it handled) if name matches the
+  // filter. bytes is the input size of one iteration, for throughput.
+  inline void run(const std::string &name, std::uint64_t bytes,
+                  const std::function<std::uint64_t()> &body) {
+    if (!this->matches(name)) {
+      return;
+    }
+    std::uint64_t iterations = 0, items = 0;
+    auto start = std::chrono::steady_clock::now();
+    std::clock_t cpu_start = std::clock();
+    double elapsed = 0;
+    do {
+      items += body();
+      iterations++;
+      elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                              start)
+                    .count();
+    } while (elapsed < this->min_time);
+
+    double cpu = double(std::clock() - cpu_start) / CLOCKS_PER_SEC;
+    Result r = {name,  iterations, elapsed * 1e9 / iterations,
+                cpu * 1e9 / iterations, bytes, items / iterations};
+    this->results.push_back(r);
+    fprintf(stderr, "%-50s %12.0f ns %10.2f MB/s\n", name.c_str(), r.ns,
+            r.bytes ? r.bytes / (r.ns / 1e9) / (1024 * 1024) : 0.0);
+  }
+
+  inline void write_json(FILE *out) const {
+    fprintf(out, "{\n  \"context\": {\"library_build_type\": \"%s\"},\n"
+                 "  \"benchmarks\": [\n",
+#ifdef NDEBUG
+            "release"
+#else
+            "debug"
+#endif
+    );
+    for (std::size_t i = 0; i < this->results.size(); i++) {
+      const Result &r = this->results[i];
+      double seconds = r.ns / 1e9;
+      fprintf(out,
+              "    {\"name\": \"%s\", \"run_type\": \"iteration\", "
+              "\"iterations\": %llu, \"real_time\": %.1f, \"cpu_time\": %.1f, "
+              "\"time_unit\": \"ns\", \"bytes_per_second\": %.1f, "
+              "\"items_per_second\": %.1f}%s\n",
+              r.name.c_str(), (unsigned long long)r.iterations, r.ns, r.cpu_ns,
+              seconds > 0 ? r.bytes / seconds : 0.0,
+              seconds > 0 ? r.items / seconds : 0.0,
+              i + 1 < this->results.size() ? "," : "");
+    }
+    fprintf(out, "  ]\n}\n");
+  }
+};
+
+#endif
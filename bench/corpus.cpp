@@ -0,0 +1,129 @@
+#include "corpus.h"
+#include <cstdint>
+#include <string>
+
+namespace {
+// Small deterministic generator, the standard engines differ between
+// library versions
+class Rng {
+private:
+  std::uint64_t state;
+
+public:
+  inline Rng(std::uint64_t seed) : state(seed * 0x9e3779b97f4a7c15ULL + 1) {}
+  inline std::uint32_t next() {
+    this->state ^= this->state << 13;
+    this->state ^= this->state >> 7;
+    this->state ^= this->state << 17;
+    return std::uint32_t(this->state >> 16);
+  }
+  inline std::uint32_t below(std::uint32_t n) { return this->next() % n; }
+};
+
+const char *const keywords[] = {"and",   "class", "else", "false", "func",
+                                "for",   "if",    "nil",  "or",    "return",
+                                "super", "this",  "true", "var",   "while",
+                                "list",  "print"};
+const char *const puncts[] = {"(", ")", "[", "]", "{", "}", ",", ".",
+                              ":", ";", "+", "-", "*", "/", "!", "=",
+                              "<", ">", ">=", "<=", "==", "!="};
+
+std::string ident(Rng &rng) {
+  static const char letters[] = "abcdefghijklmnopqrstuvwxyz_";
+  std::string s(1, letters[rng.below(sizeof(letters) - 1)]);
+  std::size_t n = 2 + rng.below(10);
+  for (std::size_t i = 0; i < n; i++) {
+    s += rng.below(4) ? letters[rng.below(sizeof(letters) - 1)]
+                      : char('0' + rng.below(10));
+  }
+  return s;
+}
+
+std::string number(Rng &rng) {
+  std::string s = std::to_string(rng.below(100000));
+  if (rng.below(2)) {
+    s += "." + std::to_string(rng.below(1000));
+  }
+  return s;
+}
+
+std::string mixed_line(Rng &rng, std::size_t n) {
+  std::string f = "f" + std::to_string(n);
+  std::string a = ident(rng), b = ident(rng);
+  switch (rng.below(4)) {
+  case 0:
+    return "func " + f + "(" + a + ", " + b + ") { var x = " + a + " * " +
+           number(rng) + " + " + b + "; if (x >= " + number(rng) +
+           ") { return \"" + ident(rng) + " " + ident(rng) +
+           "\"; } return x != nil and true; }";
+  case 1:
+    return "class C" + std::to_string(n) + " { " + a + "() { this." + b +
+           " = [" + number(rng) + ", " + number(rng) + "]; print super." + a +
+           "(); } }";
+  case 2:
+    return "for (var i = 0; i < " + number(rng) + "; i = i + 1) { " + a +
+           " = " + a + " - " + b + " / 2; }";
+  default:
+    return "while (" + a + " <= " + b + " or !false) { print " + a + "; " +
+           a + " = " + a + " + 1; }";
+  }
+}
+} // namespace
+
+const char *Corpus::kind_name(Kind kind) {
+  switch (kind) {
+  case MIXED:
+    return "mixed";
+  case IDENT:
+    return "ident";
+  case KEYWORD:
+    return "keyword";
+  case NUMBER:
+    return "number";
+  case STRING:
+    return "string";
+  case PUNCT:
+    return "punct";
+  }
+  return "unknown";
+}
+
+std::string Corpus::generate(Kind kind, std::size_t size, unsigned seed) {
+  Rng rng(seed);
+  std::string out;
+  out.reserve(size + 256);
+  std::size_t n = 0;
+  while (out.size() < size) {
+    std::string line;
+    if (kind == MIXED) {
+      line = mixed_line(rng, n);
+    } else {
+      for (int i = 0; i < 12; i++) {
+        if (i) {
+          line += ' ';
+        }
+        switch (kind) {
+        case IDENT:
+          line += ident(rng);
+          break;
+        case KEYWORD:
+          line += keywords[rng.below(sizeof(keywords) / sizeof(keywords[0]))];
+          break;
+        case NUMBER:
+          line += number(rng);
+          break;
+        case STRING:
+          line += "\"" + ident(rng) + " " + ident(rng) + "\"";
+          break;
+        default:
+          line += puncts[rng.below(sizeof(puncts) / sizeof(puncts[0]))];
+          break;
+        }
+      }
+    }
+    out += line;
+    out += '\n';
+    n++;
+  }
+  return out;
+}
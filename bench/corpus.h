@@ -0,0 +1,30 @@
+#pragma once
+#ifndef __CORPUS_H__
+#define __CORPUS_H__
+
+#include <cstddef>
+#include <string>
+
+// Synthetic Lox sources for the benchmarks. The same kind, size and seed
+// always give the same text, so numbers stay comparable between runs.
+class Corpus {
+public:
+  enum Kind {
+    // a plausible program: functions, classes, loops, every token class
+    MIXED,
+    // one token class each
+    IDENT,
+    KEYWORD,
+    NUMBER,
+    STRING,
+    PUNCT,
+  };
+
+  static const char *kind_name(Kind kind);
+
+  // At least size bytes (one line over at most), made of whole lines
+  static std::string generate(Kind kind, std::size_t size,
+                              unsigned seed = 42);
+};
+
+#endif
@@ -0,0 +1,203 @@
+#!/usr/bin/env python3
+"""End-to-end benchmark: run cpplox over the programs in bench/programs.
+
+Every program (plus a generated 100k-line file) is run --runs times. The
+report has the median and p95 wall time and the peak resident memory of
+each, as measured by the peak_rss helper (bench/rss) that runs cpplox.
+With --baseline the results are compared against a saved report and the
+exit status is 1 if any median time or peak memory grew by more than
+--threshold percent; --save writes the report so it can become the next
+baseline.
+
+    bench/macro.py --cpplox build/bin/cpplox [--peak-rss build/bin/peak_rss]
+                   [--runs 10] [--baseline base.json] [--threshold 5]
+                   [--save out.json]
+"""
+
+import argparse
+import json
+import os
+import random
+import subprocess
+import sys
+import tempfile
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+PROGRAMS = os.path.join(HERE, "programs")
+
+GENERATED = "generated_100k.lox"
+GENERATED_LINES = 100000
+
+
+def generate(path, lines, seed=1):
+    """Write a deterministic script of about `lines` lines."""
+    rng = random.Random(seed)
+    out = []
+    n = 0
+    f = 0
+    while n < lines:
+        kind = rng.randrange(4)
+        if kind == 0:
+            out.append("func f%d(a, b) {" % f)
+            out.append("  var x = a * %d.%d + b;" % (rng.randrange(1000),
+                                                     rng.randrange(100)))
+            out.append("  if (x >= %d and b != nil) {" % rng.randrange(100))
+            out.append("    return \"big %d\";" % f)
+            out.append("  }")
+            out.append("  return f%d(x - 1, !b) or x;" % max(f - 1, 0))
+            out.append("}")
+            f += 1
+        elif kind == 1:
+            out.append("class C%d : Base {" % f)
+            out.append("  init(v) { this.v = v; }")
+            out.append("  get() { return super.get() + this.v; }")
+            out.append("}")
+            f += 1
+        elif kind == 2:
+            out.append("for (var i = 0; i < %d; i = i + 1) {" %
+                       rng.randrange(1, 100))
+            out.append("  while (i <= %d) print i / 2;" % rng.randrange(50))
+            out.append("}")
+        else:
+            out.append("// comment %d" % rng.randrange(1 << 30))
+            out.append("var s%d = \"%s\";" % (n, "x" * rng.randrange(40)))
+        n = len(out)
+    with open(path, "w") as fp:
+        fp.write("\n".join(out[:lines]))
+        fp.write("\n")
+
+
+def run_once(peak_rss, cpplox, program):
+    """Wall seconds and peak RSS in KiB of one run.
+
+    The kernel carries a process's peak RSS across exec, so a cpplox
+    forked from here would report the Python image as its peak. peak_rss
+    forks it from a small C++ image instead, and times it there too.
+    """
+    with tempfile.TemporaryFile() as err, \
+            tempfile.NamedTemporaryFile("r") as report:
+        with open(os.devnull, "w") as null:
+            code = subprocess.call([peak_rss, report.name, cpplox, program],
+                                   stdout=null, stderr=err)
+        if code != 0:
+            err.seek(0)
+            sys.exit("%s failed with status %d:\n%s" %
+                     (os.path.basename(program), code,
+                      err.read().decode(errors="replace")))
+        wall_ns, rss_kib = report.read().split()
+    return int(wall_ns) / 1e9, int(rss_kib)
+
+
+def percentile(values, p):
+    values = sorted(values)
+    k = (len(values) - 1) * p / 100.0
+    lo = int(k)
+    hi = min(lo + 1, len(values) - 1)
+    return values[lo] + (values[hi] - values[lo]) * (k - lo)
+
+
+def measure(peak_rss, cpplox, program, runs, warmup):
+    for _ in range(warmup):
+        run_once(peak_rss, cpplox, program)
+    times, rss = [], []
+    for _ in range(runs):
+        t, m = run_once(peak_rss, cpplox, program)
+        times.append(t)
+        rss.append(m)
+    return {
+        "runs": runs,
+        "median_ms": percentile(times, 50) * 1e3,
+        "p95_ms": percentile(times, 95) * 1e3,
+        "peak_rss_kib": max(rss),
+    }
+
+
+def compare(results, baseline, threshold):
+    """Print the change against baseline, return the names that regressed.
+
+    Median time and peak memory are held to the same threshold.
+    """
+    regressed = []
+    for key, unit in (("median_ms", "ms"), ("peak_rss_kib", "KiB")):
+        print()
+        print("%-24s %12s %12s %9s" % ("vs baseline", "base " + unit,
+                                       "now " + unit, "change"))
+        for name, now in results.items():
+            base = baseline.get(name)
+            if base is None or key not in base:
+                print("%-24s %12s %12.2f %9s" % (name, "-", now[key], "new"))
+                continue
+            change = (now[key] / base[key] - 1.0) * 100.0
+            mark = ""
+            if change > threshold:
+                if name not in regressed:
+                    regressed.append(name)
+                mark = "  REGRESSED"
+            print("%-24s %12.2f %12.2f %+8.1f%%%s" %
+                  (name, base[key], now[key], change, mark))
+    return regressed
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("--cpplox", required=True, help="path to the binary")
+    ap.add_argument("--runs", type=int, default=10)
+    ap.add_argument("--warmup", type=int, default=1)
+    ap.add_argument("--filter", default="",
+                    help="only run programs whose name contains this")
+    ap.add_argument("--baseline", help="report to compare against")
+    ap.add_argument("--peak-rss",
+                    help="path to the peak_rss helper (default: next to "
+                    "--cpplox)")
+    ap.add_argument("--threshold", type=float, default=5.0,
+                    help="allowed growth of the median time and of the "
+                    "peak memory in percent (default 5)")
+    ap.add_argument("--save", help="write the report here")
+    args = ap.parse_args()
+
+    if args.runs < 1:
+        sys.exit("--runs must be at least 1")
+    peak_rss = args.peak_rss or os.path.join(
+        os.path.dirname(os.path.abspath(args.cpplox)), "peak_rss")
+    if not os.access(peak_rss, os.X_OK):
+        sys.exit("%s is not an executable, build the peak_rss target or "
+                 "pass --peak-rss" % peak_rss)
+
+    with tempfile.TemporaryDirectory() as tmp:
+        programs = sorted(os.path.join(PROGRAMS, p)
+                          for p in os.listdir(PROGRAMS) if p.endswith(".lox"))
+        generated = os.path.join(tmp, GENERATED)
+        generate(generated, GENERATED_LINES)
+        programs.append(generated)
+
+        results = {}
+        print("%-24s %12s %12s %12s" % ("program", "median ms", "p95 ms",
+                                        "peak KiB"))
+        for program in programs:
+            name = os.path.basename(program)
+            if args.filter not in name:
+                continue
+            r = measure(peak_rss, args.cpplox, program, args.runs, args.warmup)
+            results[name] = r
+            print("%-24s %12.2f %12.2f %12d" % (name, r["median_ms"],
+                                                r["p95_ms"],
+                                                r["peak_rss_kib"]))
+
+    if args.save:
+        with open(args.save, "w") as fp:
+            json.dump(results, fp, indent=2, sort_keys=True)
+            fp.write("\n")
+
+    if args.baseline:
+        with open(args.baseline) as fp:
+            baseline = json.load(fp)
+        regressed = compare(results, baseline, args.threshold)
+        if regressed:
+            print("\n%d program(s) slower or bigger than the baseline by "
+                  "more than %.1f%%" % (len(regressed), args.threshold))
+            return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
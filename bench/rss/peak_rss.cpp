@@ -0,0 +1,62 @@
+// Run a command and report its wall time and peak resident memory, for
+// bench/macro.py:
+//
+//   peak_rss <report file> <program> [args...]
+//
+// writes "<wall ns> <peak KiB>" to the report file and exits with the
+// program's status. The peak the kernel keeps for a process survives
+// exec, so a program forked straight from Python starts out with the
+// whole interpreter as its peak. Forked from here it starts with this
+// small image instead, which is below what cpplox itself touches.
+
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+int main(int argc, char **argv) {
+  if (argc < 3) {
+    fprintf(stderr, "Usage: peak_rss <report file> <program> [args...]\n");
+    exit(EXIT_FAILURE);
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  pid_t pid = fork();
+  if (pid < 0) {
+    perror("fork");
+    exit(EXIT_FAILURE);
+  }
+  if (pid == 0) {
+    execv(argv[2], argv + 2);
+    perror(argv[2]);
+    _exit(127);
+  }
+
+  int status;
+  struct rusage usage;
+  while (wait4(pid, &status, 0, &usage) < 0) {
+    if (errno != EINTR) {
+      perror("wait4");
+      exit(EXIT_FAILURE);
+    }
+  }
+  auto wall = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now() - start);
+
+  FILE *report = fopen(argv[1], "w");
+  if (report == nullptr) {
+    fprintf(stderr, "Unable to open file %s\n", argv[1]);
+    exit(EXIT_FAILURE);
+  }
+  // ru_maxrss is in KiB on Linux
+  fprintf(report, "%lld %ld\n", (long long)wall.count(), usage.ru_maxrss);
+  fclose(report);
+
+  if (WIFSIGNALED(status)) {
+    return 128 + WTERMSIG(status);
+  }
+  return WEXITSTATUS(status);
+}
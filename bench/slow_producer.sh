@@ -0,0 +1,39 @@
+#!/bin/sh
+# Pipe a generated script into cpplox from a producer that stalls between
+# bursts, and compare against the producer alone. With stdin prefetching the
+# difference is the lexing of the last burst, not lexing plus every stall.
+#
+#   bench/slow_producer.sh <path to cpplox> [bursts] [delay seconds]
+
+set -e
+
+CPPLOX=${1:?usage: $0 <path to cpplox> [bursts] [delay seconds]}
+BURSTS=${2:-50}
+DELAY=${3:-0.02}
+
+producer() {
+    i=0
+    while [ "$i" -lt "$BURSTS" ]; do
+        j=0
+        while [ "$j" -lt 200 ]; do
+            echo "func f${i}_${j}(a, b) { var x = a * 12.5 + b; if (x >= 10) { return \"big\"; } return x != nil and true; }"
+            j=$((j + 1))
+        done
+        sleep "$DELAY"
+        i=$((i + 1))
+    done
+}
+
+now() { date +%s.%N; }
+
+start=$(now)
+producer > /dev/null
+alone=$(awk "BEGIN { print $(now) - $start }")
+
+start=$(now)
+producer | "$CPPLOX" - > /dev/null
+piped=$(awk "BEGIN { print $(now) - $start }")
+
+echo "producer alone: ${alone}s"
+echo "producer | cpplox: ${piped}s"
+echo "overhead: $(awk "BEGIN { print $piped - $alone }")s"
@@ -0,0 +1,75 @@
+// Apply a series of edits to an IncrementalScanner and compare its tokens
+// with a full rescan of the edited text after each one.
+//
+// Input layout: the first byte is the number of edits, each edit is
+//   offset (2 bytes), removed (1 byte), inserted length (1 byte), inserted
+// and whatever is left over is the initial source.
+
+#include "incremental_scanner.h"
+#include "scanner.h"
+#include "token.h"
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+namespace {
+struct Edit {
+  std::size_t offset, removed;
+  std::string inserted;
+};
+
+void check(const IncrementalScanner &inc) {
+  const std::string &source = inc.get_source();
+  Scanner sc(source.data(), source.size());
+  std::size_t i = 0;
+  while (true) {
+    Token t = sc.take_token();
+    if (t.getType() == tok_eof) {
+      break;
+    }
+    if (i >= inc.size()) {
+      abort();
+    }
+    Token u = inc.get_token(i++);
+    if (t.getType() != u.getType() || t.getLine() != u.getLine() ||
+        t.getColumn() != u.getColumn() || t.getOffset() != u.getOffset() ||
+        t.getLexeme() != u.getLexeme()) {
+      abort();
+    }
+  }
+  if (i != inc.size()) {
+    abort();
+  }
+}
+} // namespace
+
+extern "C" int LLVMFuzzerTestOneInput(const std::uint8_t *data,
+                                      std::size_t size) {
+  if (size == 0) {
+    return 0;
+  }
+  std::size_t pos = 1;
+  std::vector<Edit> edits;
+  for (std::size_t n = data[0] % 16; n > 0 && pos + 4 <= size; n--) {
+    Edit e;
+    e.offset = data[pos] | data[pos + 1] << 8;
+    e.removed = data[pos + 2];
+    std::size_t length = data[pos + 3];
+    pos += 4;
+    length = std::min(length, size - pos);
+    e.inserted.assign(reinterpret_cast<const char *>(data) + pos, length);
+    pos += length;
+    edits.push_back(e);
+  }
+
+  IncrementalScanner inc(
+      std::string(reinterpret_cast<const char *>(data) + pos, size - pos));
+  check(inc);
+  for (const Edit &e : edits) {
+    inc.edit(e.offset, e.removed, e.inserted);
+    check(inc);
+  }
+  return 0;
+}
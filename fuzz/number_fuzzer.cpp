@@ -0,0 +1,49 @@
+// Differential check of number literal values against strtod. The input
+// bytes are turned into a literal (digits with at most one '.'), which is
+// scanned and compared bit for bit with what strtod makes of it.
+
+#include "number.h"
+#include "scanner.h"
+#include "token.h"
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+extern "C" int LLVMFuzzerTestOneInput(const std::uint8_t *data,
+                                      std::size_t size) {
+  std::string literal;
+  bool dot = false;
+  for (std::size_t i = 0; i < size; i++) {
+    // mostly digits, zeros often enough to hit the leading and trailing
+    // zero cases, and a '.' somewhere in the middle
+    if (data[i] == '.' && !dot && !literal.empty() && i + 1 < size) {
+      literal += '.';
+      dot = true;
+    } else if (data[i] >= 0xe0) {
+      literal += '0';
+    } else {
+      literal += '0' + data[i] % 10;
+    }
+  }
+  if (literal.empty()) {
+    return 0;
+  }
+
+  double expect = strtod(literal.c_str(), nullptr);
+  double parsed = NumberLiteral::parse(literal);
+
+  Scanner sc(literal.data(), literal.size());
+  Token t = sc.take_token();
+  if (t.getType() != tok_number) {
+    abort();
+  }
+  double scanned = t.getNumber();
+
+  if (memcmp(&expect, &parsed, sizeof(double)) != 0 ||
+      memcmp(&expect, &scanned, sizeof(double)) != 0) {
+    abort();
+  }
+  return 0;
+}
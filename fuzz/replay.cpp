@@ -0,0 +1,59 @@
+// Stand-in for the libFuzzer driver when the compiler has none: run every
+// file given on the command line (or every file in a given directory)
+// through the target once. Good enough to replay crashes and corpora with
+// gcc, and as a quick regression check in CI.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <dirent.h>
+#include <string>
+#include <sys/stat.h>
+#include <vector>
+
+extern "C" int LLVMFuzzerTestOneInput(const std::uint8_t *data,
+                                      std::size_t size);
+
+static void run_file(const std::string &path) {
+  FILE *fp = fopen(path.c_str(), "rb");
+  if (fp == nullptr) {
+    fprintf(stderr, "Unable to open file %s\n", path.c_str());
+    exit(EXIT_FAILURE);
+  }
+  std::vector<std::uint8_t> data;
+  std::uint8_t buf[4096];
+  std::size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), fp)) > 0) {
+    data.insert(data.end(), buf, buf + n);
+  }
+  fclose(fp);
+  LLVMFuzzerTestOneInput(data.data(), data.size());
+}
+
+int main(int argc, const char **argv) {
+  std::size_t count = 0;
+  for (int i = 1; i < argc; i++) {
+    struct stat st;
+    if (stat(argv[i], &st) == 0 && S_ISDIR(st.st_mode)) {
+      DIR *dir = opendir(argv[i]);
+      while (dir != nullptr) {
+        struct dirent *e = readdir(dir);
+        if (e == nullptr) {
+          closedir(dir);
+          break;
+        }
+        std::string path = std::string(argv[i]) + "/" + e->d_name;
+        if (stat(path.c_str(), &st) == 0 && S_ISREG(st.st_mode)) {
+          run_file(path);
+          count++;
+        }
+      }
+    } else {
+      run_file(argv[i]);
+      count++;
+    }
+  }
+  fprintf(stderr, "%s: ran %zu inputs\n", argv[0], count);
+  return 0;
+}
@@ -0,0 +1,69 @@
+// Scan arbitrary bytes in memory, check that every token points back at
+// its own source text and that the in-place MemoryScanner agrees. Built as
+// a libFuzzer target with clang, or as a replay tool for crash inputs and
+// corpora otherwise (see replay.cpp).
+
+#include "scanner.h"
+#include "token.h"
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+extern "C" int LLVMFuzzerTestOneInput(const std::uint8_t *data,
+                                      std::size_t size) {
+  const char *src = reinterpret_cast<const char *>(data);
+  Scanner sc(src, size);
+
+  std::size_t line = 1, line_start = 0, next = 0;
+  while (true) {
+    Token t = sc.take_token();
+    if (t.getType() == tok_eof) {
+      break;
+    }
+
+    // tokens come in source order, positions are 1-based
+    std::size_t start = t.getOffset() - 1;
+    if (t.getOffset() == 0 || start < next || start >= size) {
+      abort();
+    }
+    for (; next < start; next++) {
+      if (src[next] == '\n') {
+        line++;
+        line_start = next + 1;
+      }
+    }
+    if (t.getLine() != line || t.getColumn() != start - line_start + 1) {
+      abort();
+    }
+
+    // string lexemes leave out the quotes, everything else is verbatim
+    const std::string &lexeme = t.getLexeme();
+    std::size_t skip = t.getType() == tok_string ? 1 : 0;
+    std::size_t length = lexeme.size() + 2 * skip;
+    if (start + length > size ||
+        memcmp(src + start + skip, lexeme.data(), lexeme.size()) != 0) {
+      abort();
+    }
+    // a string may span lines, the next token is counted from its start
+  }
+
+  // a terminated copy read in place, NUL bytes inside included
+  std::string copy(src, size);
+  Scanner chunked(src, size);
+  MemoryScanner in_place(copy.c_str(), copy.size());
+  while (true) {
+    Token a = chunked.take_token();
+    Token b = in_place.take_token();
+    if (a.getType() != b.getType() || a.getLine() != b.getLine() ||
+        a.getColumn() != b.getColumn() || a.getOffset() != b.getOffset() ||
+        a.getLexeme() != b.getLexeme() || a.getNumber() != b.getNumber()) {
+      abort();
+    }
+    if (a.getType() == tok_eof) {
+      break;
+    }
+  }
+  return 0;
+}
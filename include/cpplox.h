@@ -0,0 +1,76 @@
+#pragma once
+#ifndef __CPPLOX_H__
+#define __CPPLOX_H__
+
+// Public header of libcpplox, for programs that embed Lox:
+//
+//   LoxScript script("handler.lox", source);   // once, at startup
+//   if (!script.ok()) { ... script.get_errors() ... }
+//
+//   thread_local LoxContext ctx;                // once per thread
+//   ctx.lex(request_body, size);                // per request, no setup
+//
+// A LoxScript is immutable after construction and can be shared by any
+// number of threads. A LoxContext belongs to one thread and keeps its
+// scanner, source and token buffers between calls, so a request costs a
+// copy and the scan and nothing else.
+//
+// Only the front end exists so far, running scripts and native functions
+// follow with the interpreter.
+
+#include "scanner.h"
+#include "token.h"
+#include <cstddef>
+#include <string>
+#include <vector>
+
+class LoxContext {
+private:
+  // the request, copied so it is terminated for the scanner
+  std::string source;
+  MemoryScanner scanner;
+  std::vector<Token> tokens;
+  std::vector<std::string> errors;
+
+public:
+  LoxContext();
+
+  LoxContext(const LoxContext &) = delete;
+  LoxContext &operator=(const LoxContext &) = delete;
+
+  // Scan size bytes of source. Returns false if there were scan errors; the
+  // tokens up to EOF are kept either way, errors included as tok_error.
+  bool lex(const char *source, std::size_t size);
+  inline bool lex(const std::string &source) {
+    return this->lex(source.data(), source.size());
+  }
+
+  // Results of the last lex(), good until the next one
+  inline const std::vector<Token> &get_tokens() const { return this->tokens; }
+  inline const std::vector<std::string> &get_errors() const {
+    return this->errors;
+  }
+};
+
+class LoxScript {
+private:
+  std::string name;
+  std::string source;
+  std::vector<Token> tokens;
+  std::vector<std::string> errors;
+
+public:
+  // Takes a copy of source and scans it
+  LoxScript(const std::string &name, const std::string &source);
+
+  inline bool ok() const { return this->errors.empty(); }
+  inline const std::string &get_name() const { return this->name; }
+  inline const std::string &get_source() const { return this->source; }
+  inline const std::vector<Token> &get_tokens() const { return this->tokens; }
+  // "name: message" for every scan error
+  inline const std::vector<std::string> &get_errors() const {
+    return this->errors;
+  }
+};
+
+#endif
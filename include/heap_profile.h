@@ -0,0 +1,76 @@
+#pragma once
+#ifndef __HEAP_PROFILE_H__
+#define __HEAP_PROFILE_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+// Heap profile (--heap-profile): every allocation made through operator new
+// is attributed to an object kind and to the Lox source line being worked
+// on, and is tracked until it is freed. The report has the top allocation
+// sites, live bytes over time and whatever is still live at exit.
+//
+// Code marks what it allocates with a Site, which costs a branch unless the
+// profile is on. Allocations outside any site count as OTHER, line 0.
+class HeapProfile {
+public:
+  enum Kind {
+    OTHER,
+    // tokens and their lexemes, including the scanner's history
+    TOKEN,
+    // runtime strings (LoxString)
+    STRING,
+    // AST nodes
+    AST,
+    KINDS,
+  };
+
+private:
+  static bool enabled;
+  // what the allocations of this thread are attributed to right now
+  static thread_local Kind current_kind;
+  static thread_local std::size_t current_line;
+
+public:
+  // Attributes the allocations made while it is in scope
+  class Site {
+  private:
+    Kind outer_kind;
+    std::size_t outer_line;
+
+  public:
+    inline Site(Kind kind, std::size_t line)
+        : outer_kind(OTHER), outer_line(0) {
+      if (enabled) {
+        this->outer_kind = current_kind;
+        this->outer_line = current_line;
+        current_kind = kind;
+        current_line = line;
+      }
+    }
+    // Keep the line of the enclosing site, for code that has none
+    inline Site(Kind kind) : Site(kind, enabled ? current_line : 0) {}
+    Site(const Site &) = delete;
+    Site &operator=(const Site &) = delete;
+    inline ~Site() {
+      if (enabled) {
+        current_kind = this->outer_kind;
+        current_line = this->outer_line;
+      }
+    }
+  };
+
+  static inline bool is_enabled() { return enabled; }
+  static void enable();
+
+  // Called by the global operator new and delete
+  static void note_allocation(void *p, std::size_t size);
+  static void note_free(void *p);
+
+  static const char *kind_name(Kind k);
+  // Top sites, a live bytes timeline and the leak report
+  static void report(FILE *out, std::size_t top);
+};
+
+#endif
@@ -0,0 +1,70 @@
+#pragma once
+#ifndef __INCREMENTAL_SCANNER_H__
+#define __INCREMENTAL_SCANNER_H__
+
+#include "token.h"
+#include <string>
+#include <vector>
+
+// Token stream of an edited buffer (editor / LSP integration). An edit only
+// rescans from the token it touches until the new tokens line up with the
+// old ones again, everything else is reused.
+//
+// Tokens live in a gap buffer: the ones before the gap store absolute
+// positions, the ones after it store their distance from the end of the
+// buffer, which no edit in front of them changes. An edit therefore costs
+// the rescanned tokens plus the distance the gap moves, not the file size.
+class IncrementalScanner {
+private:
+  struct Span {
+    TokenType type;
+    // absolute before the gap, counted from the end of the buffer after it
+    std::size_t start, line;
+    std::size_t length;
+  };
+
+  std::string source;
+  // total number of lines in source
+  std::size_t lines;
+  std::vector<Span> spans;
+  std::size_t gap_begin, gap_end;
+
+protected:
+  inline Span span(std::size_t i) const {
+    if (i < this->gap_begin) {
+      return this->spans[i];
+    }
+    Span s = this->spans[i - this->gap_begin + this->gap_end];
+    s.start = this->source.size() - s.start;
+    s.line = this->lines - s.line;
+    return s;
+  }
+
+  // Make the gap start in front of logical token i
+  void move_gap(std::size_t i);
+  // Append a token in front of the gap, growing it when it is full
+  void push(const Span &s);
+  // Line of an arbitrary position, pos must not be inside a token
+  std::size_t line_at(std::size_t pos) const;
+  // First token that ends at or after pos
+  std::size_t first_touching(std::size_t pos) const;
+  // Scan from pos until the tokens line up with the ones after the gap again
+  void rescan(std::size_t pos);
+
+public:
+  IncrementalScanner(const std::string &source);
+
+  // Replace removed bytes at offset with inserted
+  void edit(std::size_t offset, std::size_t removed,
+            const std::string &inserted);
+
+  inline std::size_t size() const {
+    return this->spans.size() - (this->gap_end - this->gap_begin);
+  }
+  // Token i, positioned like the ones Scanner::next_token() returns
+  Token get_token(std::size_t i) const;
+
+  inline const std::string &get_source() const { return this->source; }
+};
+
+#endif
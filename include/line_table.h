@@ -0,0 +1,69 @@
+#pragma once
+#ifndef __LINE_TABLE_H__
+#define __LINE_TABLE_H__
+
+#include <cstddef>
+#include <vector>
+
+// Where every line of an input starts, so that line and column follow from
+// a byte offset alone. An input adds its bytes as they arrive and the
+// newlines are found 16 bytes at a time (SSE2), instead of counting lines
+// and columns byte by byte. Every position the scanner and diagnostics
+// report comes from here.
+class LineTable {
+private:
+  // 0-based offset of the first byte of every line, starts[0] is 0
+  std::vector<std::size_t> starts;
+  // bytes added so far
+  std::size_t size;
+
+public:
+  inline LineTable() : starts(1, 0), size(0) {}
+
+  inline void clear() {
+    this->starts.assign(1, 0);
+    this->size = 0;
+  }
+
+  // Add the next size bytes of the input
+  void add(const char *data, std::size_t size);
+
+  // Lines seen so far
+  inline std::size_t count() const { return this->starts.size(); }
+  // 0-based offset of the first byte of a 1-based line
+  inline std::size_t start(std::size_t line) const {
+    return this->starts[line - 1];
+  }
+
+  // 1-based line of the byte at 0-based pos. hint is a line at or before
+  // pos, usually the result of the previous lookup, which makes lookups in
+  // increasing order amortized constant. Anything else is a binary search.
+  inline std::size_t line_of(std::size_t pos, std::size_t hint = 1) const {
+    std::size_t n = this->starts.size();
+    if (hint < 1 || hint > n || this->starts[hint - 1] > pos) {
+      return this->search(pos);
+    }
+    while (hint < n && this->starts[hint] <= pos) {
+      hint++;
+    }
+    return hint;
+  }
+  std::size_t search(std::size_t pos) const;
+
+  // Column of a reader at 1-based offset: of the byte it returned last, or
+  // of the end of the input once it is used up. line is the hint on the way
+  // in and the line of that position on the way out.
+  inline std::size_t locate(std::size_t offset, bool end,
+                            std::size_t &line) const {
+    std::size_t pos = offset > 0 && !end ? offset - 1 : offset;
+    line = this->line_of(pos, line);
+    return offset - this->starts[line - 1];
+  }
+
+  // 1-based column of the byte at 0-based pos
+  inline std::size_t column_of(std::size_t pos) const {
+    return pos - this->start(this->line_of(pos)) + 1;
+  }
+};
+
+#endif
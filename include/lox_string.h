@@ -0,0 +1,92 @@
+#pragma once
+#ifndef __LOX_STRING_H__
+#define __LOX_STRING_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Immutable runtime string value, what a tok_string literal and every
+// string operation evaluate to. Copies are cheap: short strings live inline
+// in the handle, longer ones in a reference counted node.
+//
+// Concatenation never copies the left side when it does not have to:
+//   - if the left string ends where its node's text ends and the node has
+//     room, the right side is appended in place. Handles that see a shorter
+//     prefix of the node are not affected, so `s = s + x` in a loop is
+//     amortized linear like a growing buffer.
+//   - otherwise long results become a rope node pointing at both halves,
+//     with small right sides collected into chunk sized leaves.
+// A rope is flattened the first time it is indexed, hashed or compared, and
+// the flat text is kept in the node for every handle that shares it.
+//
+// Reference counts are not atomic and reads may flatten, so a string must
+// stay with the thread (interpreter context) that made it.
+class LoxString {
+private:
+  struct Node;
+
+  static constexpr std::size_t INLINE_SIZE = 15;
+
+  std::size_t length;
+  // 0 until hash() is called
+  mutable std::uint32_t hash_value;
+  // node is set, short strings can be on the heap too (rope leaves)
+  bool heap;
+  union {
+    char chars[INLINE_SIZE + 1];
+    Node *node;
+  };
+
+protected:
+  inline bool is_inline() const { return !this->heap; }
+
+  // Handle on the first length bytes of node, taking a reference
+  LoxString(Node *node, std::size_t length);
+
+  // New nodes start without references
+  static Node *new_flat(std::size_t capacity);
+  static Node *new_rope(const LoxString &left, const LoxString &right);
+
+  // Drop a reference, freeing whole ropes without recursing into them
+  static void release(Node *node);
+  // Make node flat, iteratively, ropes can be millions of nodes deep
+  static void flatten(Node *node);
+
+public:
+  inline LoxString() : length(0), hash_value(0), heap(false) {
+    this->chars[0] = '\0';
+  }
+  LoxString(const char *data, std::size_t size);
+  inline LoxString(const std::string &s) : LoxString(s.data(), s.size()) {}
+
+  LoxString(const LoxString &o);
+  LoxString(LoxString &&o);
+  LoxString &operator=(const LoxString &o);
+  LoxString &operator=(LoxString &&o);
+  ~LoxString();
+
+  inline std::size_t size() const { return this->length; }
+  inline bool empty() const { return this->length == 0; }
+  // Still an unflattened rope
+  bool is_rope() const;
+
+  // The text, not terminated. Flattens a rope.
+  const char *data() const;
+  inline char operator[](std::size_t i) const { return this->data()[i]; }
+  inline std::string str() const {
+    return std::string(this->data(), this->length);
+  }
+
+  // FNV-1a of the text, computed once per handle
+  std::uint32_t hash() const;
+
+  bool operator==(const LoxString &o) const;
+  inline bool operator!=(const LoxString &o) const { return !(*this == o); }
+
+  friend LoxString operator+(const LoxString &a, const LoxString &b);
+};
+
+LoxString operator+(const LoxString &a, const LoxString &b);
+
+#endif
@@ -0,0 +1,61 @@
+#pragma once
+#ifndef __NUMBER_H__
+#define __NUMBER_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Value of a number literal (digits with an optional fraction), built up
+// while the scanner walks the digits so the lexeme never has to be parsed
+// again.
+//
+// The first 19 significant digits are kept in an integer mantissa. When the
+// mantissa and the power of ten are both small enough to be exact doubles a
+// single multiplication or division gives the correctly rounded result
+// (Clinger's fast path), which covers nearly every literal in real scripts.
+// Everything else goes to strtod in the C locale.
+class NumberLiteral {
+private:
+  static constexpr int MAX_DIGITS = 19;
+
+  std::uint64_t mantissa;
+  // value = mantissa * 10^exponent, if nothing was truncated
+  int exponent;
+  int digits;
+  // non-zero digits beyond MAX_DIGITS were dropped
+  bool truncated;
+
+protected:
+  bool fast_value(double &value) const;
+
+public:
+  inline NumberLiteral()
+      : mantissa(0), exponent(0), digits(0), truncated(false) {}
+
+  // Add the next digit d (0-9), fraction is true after the '.'
+  inline void push_digit(int d, bool fraction) {
+    if (this->digits < MAX_DIGITS) {
+      if (this->mantissa == 0 && d == 0) {
+        // leading zero, only its position matters
+        this->exponent -= fraction;
+        return;
+      }
+      this->mantissa = this->mantissa * 10 + d;
+      this->exponent -= fraction;
+      this->digits++;
+      return;
+    }
+    this->truncated |= d != 0;
+    this->exponent += !fraction;
+  }
+
+  // Correctly rounded value, lexeme is only read when the fast path can not
+  // be taken
+  double value(const std::string &lexeme) const;
+
+  // Parse a whole literal
+  static double parse(const std::string &lexeme);
+};
+
+#endif
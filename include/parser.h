@@ -37,6 +37,9 @@ public:
   inline Parser(const std::string &filename)
       : scanner(new Scanner(filename)), ast(nullptr) {}
   inline Parser() : scanner(new Scanner()), ast(nullptr) {}
+  // Parse size bytes of data, which has to outlive the Parser
+  inline Parser(const char *data, std::size_t size)
+      : scanner(new Scanner(data, size)), ast(nullptr) {}
 
   Parser(const Parser &) = delete;
   Parser &operator=(const Parser &) = delete;
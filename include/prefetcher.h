@@ -0,0 +1,61 @@
+#pragma once
+#ifndef __PREFETCHER_H__
+#define __PREFETCHER_H__
+
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <sys/types.h>
+#include <thread>
+
+// Background reader for stdin and pipes. A reader thread keeps a ring of
+// chunks filled ahead of the scanner, so a slow producer on the other end of
+// the pipe never leaves the scanner blocked in read() while there is
+// already data to lex.
+class Prefetcher {
+private:
+  static constexpr std::size_t SLOTS = 3;
+  static constexpr std::size_t SLOT_SIZE = 64 * 1024;
+
+  struct Slot {
+    // SLOT_SIZE bytes plus room for a terminator
+    char *data;
+    // bytes read, 0 at EOF and -1 on error
+    ssize_t size;
+  };
+
+  int fd;
+  // self-pipe, written to wake the reader out of poll() when stopping
+  int wake[2];
+  Slot slots[SLOTS];
+  std::mutex lock;
+  std::condition_variable cv;
+  // chunks read so far, and chunks the consumer is done with
+  std::size_t filled, released;
+  // the consumer holds slot released % SLOTS
+  bool holding;
+  bool stopping;
+  std::thread reader;
+
+protected:
+  void run();
+
+public:
+  Prefetcher(int fd);
+
+  Prefetcher(const Prefetcher &) = delete;
+  Prefetcher &operator=(const Prefetcher &) = delete;
+
+  ~Prefetcher();
+
+  // Stop reading ahead, a next() waiting for input returns 0 as if at EOF.
+  // For a consumer that gives up early, from any thread.
+  void cancel();
+
+  // Hand back the previous chunk and wait for the next one. Returns its
+  // size, 0 at EOF and -1 on error. The chunk has one spare byte after its
+  // end and stays valid until the next call.
+  ssize_t next(char **data);
+};
+
+#endif
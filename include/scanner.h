@@ -3,6 +3,8 @@
 #ifndef __SCANNER_H__
 #define __SCANNER_H__
 
+#include "line_table.h"
+#include "prefetcher.h"
 #include "token.h"
 #include <cstdint>
 #include <cstdio>
@@ -10,37 +12,78 @@
 #include <cstring>
 #include <fcntl.h>
 #include <fstream>
+#include <functional>
+#include <iterator>
 #include <string>
+#include <sys/stat.h>
 #include <unistd.h>
 #include <vector>
 
+// Keyword type of an identifier lexeme, tok_ident if it is no keyword
+TokenType keyword_type(const std::string &lexeme);
+
+// Message for a tok_error token, e.g. "Unknown character @ at line 3,
+// column 7"
+std::string scan_error(const Token &t);
+
 class File {
 private:
-  static constexpr std::size_t FILE_BUF_SIZE = 64;
+  // big enough that read() and the line table scan run on whole blocks
+  static constexpr std::size_t FILE_BUF_SIZE = 4096;
   const std::string filename;
   int fd;
   char *buffer;
   std::size_t buffer_size;
-  char *current, *end;
-  std::size_t line, column, offset;
+  // the chunk being scanned, which is not always in buffer
+  char *chunk, *current, *end;
+  // offset of the first byte of chunk
+  std::size_t base;
+  LineTable lines;
+  // line of the last position asked for, the hint of the next lookup
+  mutable std::size_t line;
+  // Caller owned input, when not reading from fd
+  const char *memory;
+  std::size_t memory_size, memory_pos;
+  // Reads ahead on another thread, for stdin and pipes
+  Prefetcher *prefetch;
 
-  bool newline;
+  // the input is used up
+  bool done;
 
 protected:
   // Check if buffer is empty
   inline bool buffer_empty() const { return this->current == this->end; }
-  // Check if EOF
-  inline bool eof() const { return *(this->current) == EOF; }
+  // Check if EOF. A flag rather than an EOF byte in the buffer, 0xff is a
+  // perfectly fine input byte.
+  inline bool eof() const { return this->done; }
   // Read a buf_size chunk of data from the file
   void read_a_chunk();
 
-  void update_pos(bool newline = false);
+  // Slow path of next_char(): refill or EOF
+  int next_char_slow();
+
+  inline void alloc_buffer() {
+    this->buffer = (char *)malloc(sizeof(char) * this->buffer_size);
+
+    if (this->buffer == nullptr) {
+      // Error
+      fprintf(stderr, "Unable to allocate memory for file buffer\n");
+      exit(EXIT_FAILURE);
+    }
+
+    memset(this->buffer, 0, this->buffer_size);
+
+    this->chunk = this->buffer;
+    this->current = this->buffer;
+    this->end = this->buffer;
+  }
 
 public:
   inline File(const std::string &filename)
       : filename(filename), fd(-1), buffer(nullptr), buffer_size(FILE_BUF_SIZE),
-        current(nullptr), end(nullptr), line(1), column(0), offset(0),
-        newline(false) {
+        chunk(nullptr), current(nullptr), end(nullptr), base(0), line(1),
+        memory(nullptr), memory_size(0), memory_pos(0), prefetch(nullptr),
+        done(false) {
     if (filename == "-") {
       this->fd = STDIN_FILENO;
     } else {
@@ -55,27 +98,50 @@ public:
       }
     }
 
-    this->buffer = (char *)malloc(sizeof(char) * this->buffer_size);
-
-    if (this->buffer == nullptr) {
-      // Error
-      fprintf(stderr, "Unable to allocate memory for file buffer\n");
-      exit(EXIT_FAILURE);
+    // Regular files are always ready, everything else may make read()
+    // wait on whoever is writing
+    struct stat st;
+    if (fstat(this->fd, &st) == 0 && !S_ISREG(st.st_mode)) {
+      this->prefetch = new Prefetcher(this->fd);
     }
 
-    memset(this->buffer, 0, this->buffer_size);
+    this->alloc_buffer();
+  }
+
+  inline File() : File("-") {}
+
+  // Read from memory instead of a file. data is copied chunk by chunk as it
+  // is consumed, so it has to outlive the File.
+  inline File(const char *data, std::size_t size,
+              const std::string &name = "memory")
+      : filename(name), fd(-1), buffer(nullptr), buffer_size(FILE_BUF_SIZE),
+        chunk(nullptr), current(nullptr), end(nullptr), base(0), line(1),
+        memory(data), memory_size(size), memory_pos(0), prefetch(nullptr),
+        done(false) {
+    this->alloc_buffer();
+  }
 
+  // Start over on new in-memory input, keeping the buffer. Only for a File
+  // that reads from memory.
+  inline void reset(const char *data, std::size_t size) {
+    this->memory = data;
+    this->memory_size = size;
+    this->memory_pos = 0;
+    this->chunk = this->buffer;
     this->current = this->buffer;
     this->end = this->buffer;
+    this->base = 0;
+    this->lines.clear();
+    this->line = 1;
+    this->done = false;
   }
 
-  inline File() : File("-") {}
-
   File(const File &) = delete;
   File(const File &&) = delete;
   File &operator=(const File &) = delete;
 
   inline ~File() {
+    delete this->prefetch;
     if (this->fd != STDIN_FILENO && this->fd != -1) {
       close(this->fd);
     }
@@ -83,9 +149,28 @@ public:
   }
 
   inline bool is_from_file() const { return this->fd != STDIN_FILENO; }
-  inline std::size_t get_line() const { return this->line; }
-  inline std::size_t get_column() const { return this->column; }
-  inline std::size_t get_offset() const { return this->offset; }
+  // 1-based offset of the byte returned last, the size once it is used up
+  inline std::size_t get_offset() const {
+    return this->base + (this->current - this->chunk);
+  }
+  // Line and column of that byte, or of the end of the input, from the
+  // table. stdin and pipes are counted like files.
+  inline void get_position(std::size_t &line, std::size_t &column) const {
+    column = this->lines.locate(this->get_offset(), this->done, this->line);
+    line = this->line;
+  }
+  inline std::size_t get_line() const {
+    std::size_t line, column;
+    this->get_position(line, column);
+    return line;
+  }
+  inline std::size_t get_column() const {
+    std::size_t line, column;
+    this->get_position(line, column);
+    return column;
+  }
+  // Newlines of everything read so far
+  inline const LineTable &get_lines() const { return this->lines; }
   inline const char *get_file() const {
     if (this->fd != STDIN_FILENO) {
       return this->filename.c_str();
@@ -95,41 +180,263 @@ public:
 
   inline bool is_eof() const { return this->eof(); }
 
-  char next_char();
+  // Make a read that waits on stdin or a pipe give up as if at EOF, from
+  // any thread. Files and memory never wait, nothing changes for them.
+  inline void cancel() {
+    if (this->prefetch) {
+      this->prefetch->cancel();
+    }
+  }
+
+  // Fast path is inlined into the scanner loops, only the end of a chunk
+  // goes through next_char_slow(). Positions come from the line table, so
+  // there is nothing to count per byte. Bytes come back as unsigned char
+  // values, so EOF is never a real byte.
+  inline int next_char() {
+    if (!this->buffer_empty()) {
+      return static_cast<unsigned char>(*(this->current++));
+    }
+    return this->next_char_slow();
+  }
 
   char peek() const;
 };
 
-class Scanner {
+// Reads a buffer in place, without copying it into chunks. data[size] has
+// to be '\0' (std::string::c_str() is): the terminator is the only end
+// check, a NUL anywhere before it is just another input byte. Bytes above
+// '\n' cost a load, a compare and an increment, the rest go through
+// next_char_slow(). Lines are counted as they go by, which is cheaper here
+// than a table lookup per token; the line table is only built for
+// get_lines().
+class MemoryInput {
+private:
+  const std::string name;
+  const char *start, *current, *end;
+  // first byte of the current line
+  const char *line_start;
+  std::size_t line;
+  // Allocated and built on the first get_lines(). Only a pointer, a table
+  // in the object would be an allocation for every input that never needs
+  // one.
+  mutable LineTable *lines;
+  mutable bool lines_built;
+  bool done;
+
+protected:
+  // Newline or terminator
+  int next_char_slow(unsigned char c);
+
+public:
+  inline MemoryInput(const char *data, std::size_t size,
+                     const std::string &name = "memory")
+      : name(name), lines(nullptr) {
+    this->reset(data, size);
+  }
+
+  // Start over on new input
+  inline void reset(const char *data, std::size_t size) {
+    // an empty input may come without a buffer
+    if (size == 0) {
+      data = "";
+    }
+    this->start = data;
+    this->current = data;
+    this->end = data + size;
+    this->line_start = data;
+    this->line = 1;
+    this->lines_built = false;
+    this->done = false;
+  }
+
+  MemoryInput(const MemoryInput &) = delete;
+  MemoryInput &operator=(const MemoryInput &) = delete;
+
+  inline ~MemoryInput() { delete this->lines; }
+
+  // Same positions as File: 1-based, of the byte returned last
+  inline std::size_t get_offset() const { return this->current - this->start; }
+  inline void get_position(std::size_t &line, std::size_t &column) const {
+    line = this->line;
+    column = this->current - this->line_start;
+  }
+  inline std::size_t get_line() const { return this->line; }
+  inline std::size_t get_column() const {
+    return this->current - this->line_start;
+  }
+  // Newlines of the whole input, found on the first call
+  inline const LineTable &get_lines() const {
+    if (this->lines == nullptr) {
+      this->lines = new LineTable();
+    }
+    if (!this->lines_built) {
+      this->lines->clear();
+      this->lines->add(this->start, this->end - this->start);
+      this->lines_built = true;
+    }
+    return *this->lines;
+  }
+  inline const char *get_file() const { return this->name.c_str(); }
+
+  inline bool is_eof() const { return this->done; }
+
+  inline int next_char() {
+    unsigned char c = *(this->current++);
+    if (c > '\n') {
+      return c;
+    }
+    return this->next_char_slow(c);
+  }
+};
+
+// A whole regular file mapped read-only and read in place as a
+// MemoryInput. The mapping is one byte longer than the file, rounded up to
+// pages, so the terminator is there even when the file fills its last page.
+class MappedInput : public MemoryInput {
+private:
+  void *map;
+  std::size_t map_size;
+
+public:
+  MappedInput(const std::string &filename);
+
+  MappedInput(const MappedInput &) = delete;
+  MappedInput &operator=(const MappedInput &) = delete;
+
+  ~MappedInput();
+};
+
+// The scanner, specialized at compile time on where its input comes from,
+// so the per-byte next_char() of the input inlines into the scanning loops.
+// Input is one of File, MemoryInput or MappedInput; next_token() is built
+// for each of them in scanner.cpp.
+template <class Input> class BasicScanner {
 private:
-  File *f;
+  Input in;
   std::vector<Token> tokens;
   int lastchar;
   bool stop;
+  std::size_t errors;
 
 protected:
-  int get_char();
+  inline int get_char() { return this->in.next_char(); }
+
+  // Push a tok_error token. Scanning goes on after it, so a caller can
+  // report every bad token of the input, or just the first and stop.
+  Token &error(std::size_t line, std::size_t column, std::size_t offset,
+               const std::string &lexeme);
 
 public:
-  inline Scanner(const std::string &filename)
-      : f(new File(filename)), lastchar(' '), stop(false) {}
+  // File or MappedInput
+  inline BasicScanner(const std::string &filename)
+      : in(filename), lastchar(' '), stop(false), errors(0) {}
 
-  inline Scanner() : f(new File()), lastchar(' '), stop(false) {}
+  // stdin, File only
+  inline BasicScanner() : in(), lastchar(' '), stop(false), errors(0) {}
 
-  Scanner(const Scanner &) = delete;
-  Scanner(const Scanner &&) = delete;
-  Scanner &operator=(const Scanner &) = delete;
+  // Scan size bytes of data, which has to outlive the Scanner. File or
+  // MemoryInput, which also wants data[size] to be '\0'.
+  inline BasicScanner(const char *data, std::size_t size)
+      : in(data, size), lastchar(' '), stop(false), errors(0) {}
 
-  inline ~Scanner() { delete this->f; }
+  BasicScanner(const BasicScanner &) = delete;
+  BasicScanner(const BasicScanner &&) = delete;
+  BasicScanner &operator=(const BasicScanner &) = delete;
 
+  // Scan new in-memory input, reusing the buffers of the old one. Only for
+  // a Scanner that reads from memory.
+  inline void reset(const char *data, std::size_t size) {
+    this->in.reset(data, size);
+    this->tokens.clear();
+    this->lastchar = ' ';
+    this->stop = false;
+    this->errors = 0;
+  }
+
+  // The returned reference is only good until the next call, the history
+  // it points into may reallocate
   Token &next_token();
   inline Token &peek_token() { return this->tokens.back(); }
+  // Next token by value, without keeping it in the history
+  inline Token take_token() {
+    Token t = std::move(this->next_token());
+    this->tokens.pop_back();
+    return t;
+  }
+  // Push every token up to and including EOF to sink, which returns false
+  // to stop early. Tokens are not kept in the history, so sink may move
+  // them away.
+  inline void scan(const std::function<bool(Token &)> &sink) {
+    while (true) {
+      Token &t = this->next_token();
+      bool eof = t.getType() == tok_eof;
+      bool more = sink(t) && !eof;
+      this->tokens.pop_back();
+      if (!more) {
+        return;
+      }
+    }
+  }
+  // Every token scanned so far
+  inline const std::vector<Token> &get_tokens() const { return this->tokens; }
 
-  inline bool is_eof() const { return this->f->is_eof(); }
+  inline bool is_eof() const { return this->in.is_eof(); }
+  // Number of tok_error tokens so far
+  inline std::size_t error_count() const { return this->errors; }
 
   inline void stop_scanning() { this->stop = true; }
+  // See File::cancel(), only for a Scanner
+  inline void cancel() { this->in.cancel(); }
+
+  inline const char *get_file() const { return this->in.get_file(); }
+  // Line starts of the input read so far, for turning any token offset
+  // into a line and column
+  inline const LineTable &get_lines() const { return this->in.get_lines(); }
+
+  // Lazy input range over the remaining tokens, up to but excluding EOF:
+  //   for (const Token &t : scanner) ...
+  class iterator {
+  private:
+    BasicScanner *sc;
+    Token current;
 
-  inline const char *get_file() const { return this->f->get_file(); }
+  public:
+    using iterator_category = std::input_iterator_tag;
+    using value_type = Token;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const Token *;
+    using reference = const Token &;
+
+    inline iterator() : sc(nullptr), current(tok_eof, 0, 0, 0) {}
+    inline explicit iterator(BasicScanner *sc)
+        : sc(sc), current(sc->take_token()) {
+      if (this->current.getType() == tok_eof) {
+        this->sc = nullptr;
+      }
+    }
+
+    inline reference operator*() const { return this->current; }
+    inline pointer operator->() const { return &this->current; }
+    inline iterator &operator++() {
+      this->current = this->sc->take_token();
+      if (this->current.getType() == tok_eof) {
+        this->sc = nullptr;
+      }
+      return *this;
+    }
+    inline bool operator==(const iterator &o) const { return this->sc == o.sc; }
+    inline bool operator!=(const iterator &o) const { return this->sc != o.sc; }
+  };
+
+  inline iterator begin() { return iterator(this); }
+  inline iterator end() { return iterator(); }
 };
 
+// Files, stdin and pipes, and caller owned memory that is not terminated
+using Scanner = BasicScanner<File>;
+// Terminated memory, read in place
+using MemoryScanner = BasicScanner<MemoryInput>;
+// Regular files, mapped instead of read
+using MappedScanner = BasicScanner<MappedInput>;
+
 #endif
\ No newline at end of file
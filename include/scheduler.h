@@ -0,0 +1,63 @@
+#pragma once
+#ifndef __SCHEDULER_H__
+#define __SCHEDULER_H__
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing thread pool. Every worker owns a deque, takes work from its
+// back and steals from the front of the others when it runs dry, so uneven
+// tasks (one huge function among thousands of tiny ones) still spread over
+// all cores.
+class TaskScheduler {
+private:
+  struct Queue {
+    std::mutex lock;
+    std::deque<std::function<void()>> tasks;
+  };
+
+  std::vector<std::unique_ptr<Queue>> queues;
+  std::vector<std::thread> threads;
+  std::mutex sleep_lock;
+  std::condition_variable wakeup;
+  // tasks submitted but not taken yet, counted before they are queued so
+  // it never drops below the tasks actually there
+  std::atomic<std::size_t> queued;
+  std::atomic<std::size_t> next_queue;
+  bool stopping;
+
+protected:
+  // Take a task, from our own queue first and then from the others. self is
+  // out of range for threads that do not own a queue.
+  bool take(std::size_t self, std::function<void()> &task);
+  void worker(std::size_t self);
+
+public:
+  // 0 threads means one per core
+  TaskScheduler(std::size_t threads = 0);
+
+  TaskScheduler(const TaskScheduler &) = delete;
+  TaskScheduler &operator=(const TaskScheduler &) = delete;
+
+  // Waits for the queued tasks, then joins the workers
+  ~TaskScheduler();
+
+  inline std::size_t size() const { return this->threads.size(); }
+
+  void submit(std::function<void()> task);
+
+  // Run task(i) for every i in [0, n) and wait for all of them. The calling
+  // thread helps out. Write results into slot i of a preallocated vector
+  // and the merged output does not depend on the schedule.
+  void parallel_for(std::size_t n,
+                    const std::function<void(std::size_t)> &task);
+};
+
+#endif
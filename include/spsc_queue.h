@@ -0,0 +1,87 @@
+#pragma once
+#ifndef __SPSC_QUEUE_H__
+#define __SPSC_QUEUE_H__
+
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <utility>
+
+// Bounded lock-free queue for exactly one producer and one consumer thread.
+// The capacity is rounded up to a power of two.
+template <class T> class SpscQueue {
+private:
+  static constexpr std::size_t CACHE_LINE = 64;
+
+  T *slots;
+  std::size_t mask;
+  // Keep the two indices on their own cache lines, the producer writes tail
+  // and the consumer head
+  char pad0[CACHE_LINE];
+  std::atomic<std::size_t> head;
+  char pad1[CACHE_LINE - sizeof(std::atomic<std::size_t>)];
+  std::atomic<std::size_t> tail;
+  char pad2[CACHE_LINE - sizeof(std::atomic<std::size_t>)];
+
+public:
+  inline explicit SpscQueue(std::size_t capacity) : head(0), tail(0) {
+    std::size_t n = 1;
+    while (n < capacity) {
+      n <<= 1;
+    }
+    this->mask = n - 1;
+    // raw storage, slots are constructed on push and destroyed on pop
+    this->slots = static_cast<T *>(::operator new(sizeof(T) * n));
+  }
+
+  SpscQueue(const SpscQueue &) = delete;
+  SpscQueue &operator=(const SpscQueue &) = delete;
+
+  inline ~SpscQueue() {
+    std::size_t h = this->head.load(std::memory_order_relaxed);
+    std::size_t t = this->tail.load(std::memory_order_relaxed);
+    for (; h != t; h++) {
+      this->slots[h & this->mask].~T();
+    }
+    ::operator delete(this->slots);
+  }
+
+  // Producer side, false if the queue is full
+  inline bool try_push(T &&value) {
+    std::size_t t = this->tail.load(std::memory_order_relaxed);
+    if (t - this->head.load(std::memory_order_acquire) > this->mask) {
+      return false;
+    }
+    new (&this->slots[t & this->mask]) T(std::move(value));
+    this->tail.store(t + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Producer side
+  inline bool full() const {
+    return this->tail.load(std::memory_order_relaxed) -
+               this->head.load(std::memory_order_acquire) >
+           this->mask;
+  }
+
+  // Consumer side
+  inline bool empty() const {
+    return this->head.load(std::memory_order_relaxed) ==
+           this->tail.load(std::memory_order_acquire);
+  }
+
+  // Consumer side, false if the queue is empty
+  inline bool try_pop(T &value) {
+    std::size_t h = this->head.load(std::memory_order_relaxed);
+    if (h == this->tail.load(std::memory_order_acquire)) {
+      return false;
+    }
+    T &slot = this->slots[h & this->mask];
+    value = std::move(slot);
+    slot.~T();
+    this->head.store(h + 1, std::memory_order_release);
+    return true;
+  }
+};
+
+#endif
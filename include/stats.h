@@ -0,0 +1,75 @@
+#pragma once
+#ifndef __STATS_H__
+#define __STATS_H__
+
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+
+// Phase timing and allocation counters (--stats). Everything is a no-op
+// until enable() is called, apart from one branch per allocation.
+class Stats {
+public:
+  enum Phase {
+    NONE,
+    READ,
+    LEX,
+    PARSE,
+    RESOLVE,
+    COMPILE,
+    EXECUTE,
+    OUTPUT,
+    PHASES,
+  };
+
+  struct Counter {
+    // exclusive time, nested phases are not counted twice
+    std::uint64_t ns;
+    std::uint64_t bytes, allocations;
+    bool ran;
+  };
+
+  // Times a phase for as long as it is in scope, and attributes the
+  // allocations made meanwhile to it
+  class Scope {
+  private:
+    Phase phase;
+    Phase outer;
+    Scope *parent;
+    std::uint64_t start, nested_ns;
+
+  public:
+    Scope(Phase phase);
+    Scope(const Scope &) = delete;
+    Scope &operator=(const Scope &) = delete;
+    ~Scope();
+  };
+
+private:
+  static bool enabled;
+  static Counter phases[PHASES];
+  static std::uint64_t tokens;
+
+public:
+  static inline bool is_enabled() { return enabled; }
+  static void enable();
+
+  static inline std::uint64_t now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return std::uint64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+  }
+
+  static inline void count_tokens(std::uint64_t n) { tokens += n; }
+
+  // Called by the global operator new, counts allocations made by the thread
+  // that runs the phases
+  static void note_allocation(std::size_t size);
+
+  static const char *phase_name(Phase p);
+
+  // Human readable table, or one JSON object
+  static void report(FILE *out, bool json);
+};
+
+#endif
@@ -6,6 +6,8 @@
 #include <string>
 
 enum TokenType {
+  // bad input, the lexeme is the offending source text
+  tok_error = -2,
   tok_eof = -1,
 
   // One character
@@ -66,24 +68,40 @@ private:
   std::string lexeme;
   TokenType type;
   std::size_t line, column, offset;
+  // value of a tok_number, parsed by the scanner
+  double number;
 
 public:
   inline Token(TokenType type, std::size_t line, std::size_t column,
                std::size_t offset, const std::string &lexeme = "")
-      : lexeme(lexeme), type(type), line(line), column(column), offset(offset) {
-  }
+      : lexeme(lexeme), type(type), line(line), column(column), offset(offset),
+        number(0) {}
+
+  inline Token(TokenType type, std::size_t line, std::size_t column,
+               std::size_t offset, const std::string &lexeme, double number)
+      : lexeme(lexeme), type(type), line(line), column(column), offset(offset),
+        number(number) {}
+
+  inline Token(const Token &) = default;
+  inline Token(Token &&) = default;
+  inline Token &operator=(const Token &) = default;
+  inline Token &operator=(Token &&) = default;
 
   virtual inline ~Token() = default;
 
-  inline std::string getLexeme() const { return lexeme; }
+  inline const std::string &getLexeme() const { return lexeme; }
 
   inline TokenType getType() const { return type; }
   inline std::size_t getLine() const { return line; }
   inline std::size_t getColumn() const { return column; }
   inline std::size_t getOffset() const { return offset; }
+  inline double getNumber() const { return number; }
 
   // friend std::ostream &operator<<(std::ostream &, const Token &);
 };
+// Upper case name of a token type ("LPAREN", "EOF", ...)
+const char *token_type_name(TokenType t);
+
 std::ostream &operator<<(std::ostream &out, const Token &t);
 std::ostream &operator<<(std::ostream &out, const TokenType &t);
 
@@ -0,0 +1,114 @@
+#pragma once
+#ifndef __TOKEN_CACHE_H__
+#define __TOKEN_CACHE_H__
+
+#include "token.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// On-disk cache of a scanned token stream, stored next to the script as
+// <script>.loxc. The cache is keyed by a hash of the source text, so an
+// edited script simply misses and gets rescanned.
+//
+// Layout (host byte order, all sections 8-byte aligned, every offset is
+// relative to its section so the file can be mapped anywhere):
+//   LoxcHeader
+//   LoxcToken   tokens[token_count]
+//   LoxcString  strings[string_count]
+//   char        chars[chars_size]      (interned lexemes, not terminated)
+class TokenCache {
+public:
+  static constexpr std::uint32_t VERSION = 2;
+
+  struct LoxcHeader {
+    char magic[4]; // "LOXC"
+    std::uint32_t version;
+    std::uint64_t source_hash;
+    std::uint64_t source_size;
+    // hash of everything after the header
+    std::uint64_t checksum;
+    std::uint32_t token_count;
+    std::uint32_t string_count;
+    std::uint64_t chars_size;
+  };
+
+  struct LoxcToken {
+    std::int32_t type;
+    // index into the string table
+    std::uint32_t lexeme;
+    std::uint32_t line, column, offset;
+  };
+
+  struct LoxcString {
+    std::uint32_t offset, length;
+  };
+
+  // Read-only view of a fresh .loxc file, mapped and checked once and then
+  // read in place. Tools that only need to walk the tokens (linters,
+  // indexers) never build a Token or copy a lexeme.
+  class View {
+  private:
+    const char *base;
+    std::size_t map_size;
+    const LoxcToken *recs;
+    const LoxcString *strings;
+    const char *chars;
+    std::uint32_t count;
+
+  public:
+    // Maps the cache of filename, ok() is false if it is missing or stale
+    View(const std::string &filename);
+    View(const View &) = delete;
+    View &operator=(const View &) = delete;
+    ~View();
+
+    inline bool ok() const { return this->base != nullptr; }
+    inline std::uint32_t size() const { return this->count; }
+
+    inline TokenType type(std::uint32_t i) const {
+      return static_cast<TokenType>(this->recs[i].type);
+    }
+    inline std::size_t line(std::uint32_t i) const {
+      return this->recs[i].line;
+    }
+    inline std::size_t column(std::uint32_t i) const {
+      return this->recs[i].column;
+    }
+    inline std::size_t offset(std::uint32_t i) const {
+      return this->recs[i].offset;
+    }
+    // Lexeme of token i, points into the mapping and is not terminated
+    inline const char *lexeme(std::uint32_t i, std::size_t &length) const {
+      const LoxcString &s = this->strings[this->recs[i].lexeme];
+      length = s.length;
+      return this->chars + s.offset;
+    }
+  };
+
+  // Path of the cache file that belongs to a script
+  static std::string cache_path(const std::string &filename);
+
+  // Hash and size of the current contents of filename, the key its cache is
+  // stored under. Returns false if it is no readable regular file.
+  static bool source_key(const std::string &filename, std::uint64_t &hash,
+                         std::uint64_t &size);
+
+  // 64-bit hash used for both the source key and the payload checksum
+  static std::uint64_t hash(const void *data, std::size_t size);
+
+  // Load the cached tokens of filename into tokens. Returns false if there is
+  // no cache, or it is stale, truncated or corrupt.
+  static bool load(const std::string &filename, std::vector<Token> &tokens);
+
+  // (Re)write the cache of filename with tokens scanned from the contents
+  // source_key() gave before scanning. Returns false if it can not be
+  // written, the file has changed since or is over 4 GiB (positions are
+  // stored in 32 bits), which is never fatal, the script is just scanned
+  // again next time.
+  static bool store(const std::string &filename, std::uint64_t source_hash,
+                    std::uint64_t source_size,
+                    const std::vector<Token> &tokens);
+};
+
+#endif
@@ -0,0 +1,54 @@
+#pragma once
+#ifndef __TOKEN_PIPELINE_H__
+#define __TOKEN_PIPELINE_H__
+
+#include "scanner.h"
+#include "spsc_queue.h"
+#include "token.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Scans on a producer thread that runs ahead of the consumer through a
+// lock-free queue, so reading and lexing a big input overlap with whatever
+// consumes the tokens (the parser) on another core.
+class TokenPipeline {
+private:
+  Scanner scanner;
+  SpscQueue<Token> queue;
+  // A side that finds the queue empty (consumer) or full (producer) sleeps
+  // on cv. The other side only takes the lock when the flag says so.
+  std::mutex lock;
+  std::condition_variable cv;
+  std::atomic<bool> consumer_waiting, producer_waiting;
+  bool cancelled;
+  // The consumer has seen EOF, which is handed out again from then on
+  bool finished;
+  Token last;
+  std::thread producer;
+
+protected:
+  void produce();
+  // Wake the other side after a push or pop, if it is asleep
+  void notify(std::atomic<bool> &waiting);
+
+public:
+  // Start scanning filename ("-" for stdin), at most capacity tokens ahead
+  TokenPipeline(const std::string &filename, std::size_t capacity = 4096);
+
+  TokenPipeline(const TokenPipeline &) = delete;
+  TokenPipeline &operator=(const TokenPipeline &) = delete;
+
+  // Stops the producer, also one that waits for input on stdin or a pipe
+  ~TokenPipeline();
+
+  // Next token, waits for the producer if it is behind. Returns EOF at the
+  // end, and again on every call after that.
+  Token next_token();
+
+  inline const char *get_file() const { return this->scanner.get_file(); }
+};
+
+#endif
@@ -0,0 +1,61 @@
+#pragma once
+#ifndef __TOKEN_WRITER_H__
+#define __TOKEN_WRITER_H__
+
+#include "token.h"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// Token dump output. Tokens are formatted into one reusable buffer that goes
+// out with a single write() when it fills up, instead of a stream flush per
+// token.
+class TokenWriter {
+public:
+  enum Format {
+    // Same lines operator<<(std::ostream &, const Token &) prints
+    TEXT,
+    // One fixed-size BinaryToken per token, host byte order. Lexemes are not
+    // included, a token's text starts at source[offset - 1] (one later for
+    // strings, whose quotes are not part of the lexeme).
+    BINARY,
+  };
+
+  struct BinaryToken {
+    std::int32_t type;
+    std::uint32_t length;
+    std::uint64_t offset;
+    std::uint32_t line, column;
+  };
+
+private:
+  static constexpr std::size_t BUF_SIZE = 64 * 1024;
+  int fd;
+  Format format;
+  char *buffer;
+  std::size_t used;
+
+protected:
+  inline void put(const char *s, std::size_t n) {
+    if (this->used + n > BUF_SIZE) {
+      this->put_slow(s, n);
+      return;
+    }
+    memcpy(this->buffer + this->used, s, n);
+    this->used += n;
+  }
+  // Flush, then buffer s, or write it straight out if it is too big
+  void put_slow(const char *s, std::size_t n);
+  void put_uint(std::size_t v);
+
+public:
+  TokenWriter(int fd, Format format = TEXT);
+  TokenWriter(const TokenWriter &) = delete;
+  TokenWriter &operator=(const TokenWriter &) = delete;
+  ~TokenWriter();
+
+  void write(const Token &t);
+  void flush();
+};
+
+#endif
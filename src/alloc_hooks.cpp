@@ -0,0 +1,29 @@
+#include "heap_profile.h"
+#include "stats.h"
+#include <cstdlib>
+#include <new>
+
+// Part of the cpplox executable only. A program that embeds the library
+// keeps its own operator new, and --stats and --heap-profile are executable
+// flags anyway.
+
+// Count every allocation made through new, the counting itself is skipped
+// unless --stats or --heap-profile is on
+void *operator new(std::size_t size) {
+  Stats::note_allocation(size);
+  void *p = malloc(size ? size : 1);
+  if (p == nullptr) {
+    throw std::bad_alloc();
+  }
+  HeapProfile::note_allocation(p, size);
+  return p;
+}
+
+void operator delete(void *p) noexcept {
+  HeapProfile::note_free(p);
+  free(p);
+}
+void operator delete(void *p, std::size_t) noexcept {
+  HeapProfile::note_free(p);
+  free(p);
+}
@@ -0,0 +1,34 @@
+#include "cpplox.h"
+#include "scanner.h"
+#include "token.h"
+#include <string>
+#include <vector>
+
+LoxContext::LoxContext() : scanner(nullptr, 0) {}
+
+bool LoxContext::lex(const char *source, std::size_t size) {
+  // assign() and clear() keep the capacity, a context settles at the size
+  // of its biggest request
+  this->source.assign(source, size);
+  this->scanner.reset(this->source.c_str(), size);
+  this->tokens.clear();
+  this->errors.clear();
+  this->scanner.scan([this](Token &t) {
+    if (t.getType() == tok_error) {
+      this->errors.push_back(scan_error(t));
+    }
+    this->tokens.push_back(std::move(t));
+    return true;
+  });
+  return this->errors.empty();
+}
+
+LoxScript::LoxScript(const std::string &name, const std::string &source)
+    : name(name), source(source) {
+  LoxContext ctx;
+  ctx.lex(this->source);
+  this->tokens = ctx.get_tokens();
+  for (const std::string &e : ctx.get_errors()) {
+    this->errors.push_back(name + ": " + e);
+  }
+}
@@ -1,37 +1,302 @@
+#include "heap_profile.h"
 #include "scanner.h"
+#include "scheduler.h"
+#include "stats.h"
+#include "token_cache.h"
+#include "token_pipeline.h"
+#include "token_writer.h"
+#include <chrono>
 #include <cstring>
+#include <fcntl.h>
 #include <iostream>
+#include <string>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
 
 using namespace std;
 
-const char *msg = "Usage: %s [input file]\n";
+const char *msg = "Usage: %s [--cache] [--tokens=text|binary] "
+                  "[--stats[=json]] [--heap-profile] [input file]\n"
+                  "       %s --batch [file...]\n"
+                  "  --cache  reuse/refresh the scanned tokens in "
+                  "<input file>c\n"
+                  "  --tokens dump format, binary writes fixed-size records\n"
+                  "  --stats  per phase time and memory, on stderr\n"
+                  "  --heap-profile  allocations by kind and source line, "
+                  "live bytes over time and leaks, on stderr\n"
+                  "  --batch  scan every file in parallel, the file list is "
+                  "read from stdin if none is given, takes no other "
+                  "options\n";
+
+// A regular file that can be read, which is what MappedScanner wants
+static bool is_readable_file(const string &filename, size_t *size = nullptr) {
+  struct stat st;
+  if (stat(filename.c_str(), &st) != 0 || !S_ISREG(st.st_mode) ||
+      access(filename.c_str(), R_OK) != 0) {
+    return false;
+  }
+  if (size) {
+    *size = st.st_size;
+  }
+  return true;
+}
+
+// Tokens of the input, without the EOF that ends every stream
+static size_t token_count(const vector<Token> &tokens) {
+  if (!tokens.empty() && tokens.back().getType() == tok_eof) {
+    return tokens.size() - 1;
+  }
+  return tokens.size();
+}
+
+// Scan many files on a thread pool. Each file gets its own Scanner, the
+// keyword table is shared read-only. Per-file results are collected by index
+// and printed in input order once everything is done.
+static int run_batch(vector<string> files) {
+  if (files.empty()) {
+    string line;
+    while (getline(cin, line)) {
+      if (!line.empty()) {
+        files.push_back(line);
+      }
+    }
+  }
+
+  vector<string> reports(files.size());
+  vector<size_t> sizes(files.size(), 0);
+  vector<bool> failed(files.size(), false);
+
+  auto start = chrono::steady_clock::now();
+  TaskScheduler pool;
+  pool.parallel_for(files.size(), [&](size_t i) {
+    // MappedScanner gives up on the whole process when it can not map a
+    // file, so check first
+    size_t size;
+    if (!is_readable_file(files[i], &size)) {
+      reports[i] = "Unable to open file " + files[i];
+      failed[i] = true;
+      return;
+    }
+
+    // tokens are counted and dropped, no file keeps its history
+    MappedScanner sc(files[i]);
+    size_t count = 0;
+    while (!sc.is_eof()) {
+      Token t = sc.take_token();
+      if (t.getType() == tok_error) {
+        reports[i] = files[i] + ": " + scan_error(t);
+        failed[i] = true;
+        return;
+      }
+      // the same count as --stats, EOF is no token of the file
+      if (t.getType() != tok_eof) {
+        count++;
+      }
+    }
+    sizes[i] = size;
+    reports[i] = files[i] + ": " + to_string(count) + " tokens, " +
+                 to_string(size) + " bytes";
+  });
+  double seconds =
+      chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+  // stdout is flushed before anything goes to stderr, so with both on one
+  // file every line still comes out in input order
+  size_t total = 0, errors = 0;
+  for (size_t i = 0; i < files.size(); i++) {
+    if (failed[i]) {
+      fflush(stdout);
+      fprintf(stderr, "%s\n", reports[i].c_str());
+      errors++;
+    } else {
+      printf("%s\n", reports[i].c_str());
+    }
+    total += sizes[i];
+  }
+  fflush(stdout);
+
+  double mb = total / (1024.0 * 1024.0);
+  fprintf(stderr,
+          "batch: %zu files (%zu failed), %.2f MB in %.3f s, %.2f MB/s on "
+          "%zu threads\n",
+          files.size(), errors, mb, seconds, seconds > 0 ? mb / seconds : 0.0,
+          pool.size());
+  return errors ? 1 : 0;
+}
+
+// Scan everything sc reads and write the tokens out, the same for every
+// kind of input
+template <class S>
+static int lex(S &sc, TokenWriter &out, const char *filename,
+               bool use_cache) {
+  // Key the cache by the contents as they are before scanning, store()
+  // drops the tokens if the file changes underneath
+  uint64_t source_hash = 0, source_size = 0;
+  if (use_cache &&
+      !TokenCache::source_key(filename, source_hash, source_size)) {
+    use_cache = false;
+  }
+
+  // With --stats everything is lexed first, so lexing and output are timed
+  // apart
+  bool deferred = Stats::is_enabled();
+  // Otherwise tokens are written as they come and the scanner keeps no
+  // history, memory stays flat however long the input is
+  bool keep = deferred || use_cache;
+  Token scratch(tok_eof, 0, 0, 0);
+  int status = 0;
+  {
+    Stats::Scope phase(Stats::LEX);
+    while (!sc.is_eof()) {
+      Token &t = keep ? sc.next_token() : (scratch = sc.take_token());
+      if (t.getType() == tok_error) {
+        // whatever was scanned before it is still written out
+        out.flush();
+        fprintf(stderr, "%s\n", scan_error(t).c_str());
+        // the reports still come out, failing inputs are the interesting
+        // ones
+        status = EXIT_FAILURE;
+        break;
+      }
+      if (!deferred) {
+        out.write(t);
+      }
+    }
+  }
+  if (deferred) {
+    Stats::Scope phase(Stats::OUTPUT);
+    // up to the error, the same as without --stats
+    const vector<Token> &tokens = sc.get_tokens();
+    size_t n = status == 0 ? tokens.size() : tokens.size() - 1;
+    for (size_t i = 0; i < n; i++) {
+      out.write(tokens[i]);
+    }
+    out.flush();
+    Stats::count_tokens(status == 0 ? token_count(tokens) : n);
+  }
+
+  if (use_cache && status == 0) {
+    TokenCache::store(filename, source_hash, source_size, sc.get_tokens());
+  }
+  return status;
+}
+
+// The same as lex() for a plain token dump, with the scanner running ahead
+// on a thread of its own, so that waiting for input and lexing overlap with
+// formatting and writing the tokens out
+static int lex_pipelined(TokenPipeline &pipeline, TokenWriter &out) {
+  for (;;) {
+    Token t = pipeline.next_token();
+    if (t.getType() == tok_error) {
+      // the pipeline stops the scanner, however long the input still is
+      out.flush();
+      fprintf(stderr, "%s\n", scan_error(t).c_str());
+      return EXIT_FAILURE;
+    }
+    out.write(t);
+    if (t.getType() == tok_eof) {
+      return 0;
+    }
+  }
+}
 
 int main(int argc, const char **argv) {
-  Scanner *sc = nullptr;
-
-  if (argc == 1) {
-    // file = new File();
-    sc = new Scanner();
-  } else if (argc == 2) {
-    // file = new File(argv[1]);
-    if (strcmp(argv[1], "--help") == 0 || strcmp(argv[1], "-h") == 0) {
-      fprintf(stderr, msg, argv[0]);
+  const char *filename = nullptr;
+  bool use_cache = false;
+  TokenWriter::Format format = TokenWriter::TEXT;
+  bool stats_json = false;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--help") == 0 || strcmp(argv[i], "-h") == 0) {
+      fprintf(stderr, msg, argv[0], argv[0]);
+      return 0;
+    } else if (strcmp(argv[i], "--cache") == 0) {
+      use_cache = true;
+    } else if (strcmp(argv[i], "--tokens=text") == 0) {
+      format = TokenWriter::TEXT;
+    } else if (strcmp(argv[i], "--tokens=binary") == 0) {
+      format = TokenWriter::BINARY;
+    } else if (strcmp(argv[i], "--stats") == 0) {
+      Stats::enable();
+    } else if (strcmp(argv[i], "--stats=json") == 0) {
+      Stats::enable();
+      stats_json = true;
+    } else if (strcmp(argv[i], "--heap-profile") == 0) {
+      HeapProfile::enable();
+    } else if (strcmp(argv[i], "--batch") == 0) {
+      // batch mode takes no other options, rather than ignoring them
+      if (i != 1) {
+        fprintf(stderr, msg, argv[0], argv[0]);
+        return 1;
+      }
+      for (int j = i + 1; j < argc; j++) {
+        if (strncmp(argv[j], "--", 2) == 0) {
+          fprintf(stderr, msg, argv[0], argv[0]);
+          return 1;
+        }
+      }
+      return run_batch(vector<string>(argv + i + 1, argv + argc));
+    } else if (filename == nullptr) {
+      filename = argv[i];
+    } else {
+      fprintf(stderr, msg, argv[0], argv[0]);
+      return 1;
+    }
+  }
+
+  // stdin has nothing to key a cache on
+  if (filename == nullptr || strcmp(filename, "-") == 0) {
+    use_cache = false;
+  }
+
+  TokenWriter out(STDOUT_FILENO, format);
+
+  if (use_cache) {
+    vector<Token> cached;
+    bool hit;
+    {
+      Stats::Scope phase(Stats::READ);
+      hit = TokenCache::load(filename, cached);
+    }
+    if (hit) {
+      {
+        Stats::Scope phase(Stats::OUTPUT);
+        for (const Token &t : cached) {
+          out.write(t);
+        }
+        out.flush();
+      }
+      if (Stats::is_enabled()) {
+        Stats::count_tokens(token_count(cached));
+        Stats::report(stderr, stats_json);
+      }
+      HeapProfile::report(stderr, 10);
       return 0;
     }
-    sc = new Scanner(argv[1]);
-  } else {
-    fprintf(stderr, msg, argv[0]);
-    return 1;
   }
 
-  while (!sc->is_eof()) {
-    Token &t = sc->next_token();
-    cout << t << endl;
+  // Regular files are mapped, stdin and pipes read in chunks. A plain dump
+  // of those is pipelined when there is a second core to lex on, --stats
+  // times the scanner on this thread.
+  int status;
+  if (filename != nullptr && is_readable_file(filename)) {
+    MappedScanner sc(filename);
+    status = lex(sc, out, filename, use_cache);
+  } else if (!use_cache && !Stats::is_enabled() &&
+             thread::hardware_concurrency() > 1) {
+    TokenPipeline pipeline(filename ? filename : "-");
+    status = lex_pipelined(pipeline, out);
+  } else {
+    Scanner sc(filename ? filename : "-");
+    status = lex(sc, out, filename, use_cache);
   }
 
-  if (sc) {
-    delete sc;
+  if (Stats::is_enabled()) {
+    Stats::report(stderr, stats_json);
   }
+  HeapProfile::report(stderr, 10);
 
-  return 0;
-}
\ No newline at end of file
+  return status;
+}
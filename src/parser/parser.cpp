@@ -1,5 +1,6 @@
 #include "parser.h"
 #include "ast.h"
+#include "heap_profile.h"
 #include "token.h"
 
 #include <cstdarg>
@@ -8,16 +9,20 @@
 void Parser::logger_error(const char *fmt, ...) {
   va_list args;
   va_start(args, fmt);
-  fprintf(stderr, fmt, args);
+  vfprintf(stderr, fmt, args);
   va_end(args);
+  fputc('\n', stderr);
 }
 
 Ast *Parser::parse() {
   // if EOF, return ast
-  Token t = this->scanner->next_token();
-
-  while (t.getType() != TokenType::tok_eof) {
+  // Every declaration consumes its own tokens, so look at the next token on
+  // each iteration and push it back for parse_decl()
+  while (this->scanner->next_token().getType() != TokenType::tok_eof) {
     this->scanner->stop_scanning();
+    // nodes of the declaration go to the line it starts on
+    HeapProfile::Site site(HeapProfile::AST,
+                           this->scanner->peek_token().getLine());
     Declaration *decl = this->parse_decl();
     if (this->ast)
       this->ast->add_decl(decl);
@@ -0,0 +1,280 @@
+#include "lox_string.h"
+#include "heap_profile.h"
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+struct LoxString::Node {
+  std::size_t refs;
+  // the text of a flat node or of a flattened rope, null while a rope
+  char *text;
+  std::size_t used, capacity;
+  // halves of a rope, empty again once it is flattened
+  LoxString left, right;
+};
+
+namespace {
+// results shorter than this are copied instead of becoming ropes
+const std::size_t ROPE_MIN = 256;
+// room a rope leaf gets for later appends
+const std::size_t CHUNK = 1024;
+
+// through operator new rather than malloc, so --heap-profile sees the text
+char *alloc_text(std::size_t capacity) {
+  return static_cast<char *>(::operator new(capacity));
+}
+} // namespace
+
+LoxString::Node *LoxString::new_flat(std::size_t capacity) {
+  HeapProfile::Site site(HeapProfile::STRING);
+  Node *n = new Node();
+  n->refs = 0;
+  n->text = alloc_text(capacity);
+  n->used = 0;
+  n->capacity = capacity;
+  return n;
+}
+
+LoxString::Node *LoxString::new_rope(const LoxString &left,
+                                     const LoxString &right) {
+  HeapProfile::Site site(HeapProfile::STRING);
+  Node *n = new Node();
+  n->refs = 0;
+  n->text = nullptr;
+  n->used = n->capacity = 0;
+  n->left = left;
+  n->right = right;
+  return n;
+}
+
+LoxString::LoxString(Node *node, std::size_t length)
+    : length(length), hash_value(0), heap(true) {
+  this->node = node;
+  node->refs++;
+}
+
+LoxString::LoxString(const char *data, std::size_t size)
+    : length(size), hash_value(0), heap(false) {
+  if (size <= INLINE_SIZE) {
+    memcpy(this->chars, data, size);
+    this->chars[size] = '\0';
+    return;
+  }
+  Node *n = new_flat(size);
+  n->refs = 1;
+  memcpy(n->text, data, size);
+  n->used = size;
+  this->node = n;
+  this->heap = true;
+}
+
+LoxString::LoxString(const LoxString &o)
+    : length(o.length), hash_value(o.hash_value), heap(o.heap) {
+  if (o.heap) {
+    this->node = o.node;
+    this->node->refs++;
+  } else {
+    memcpy(this->chars, o.chars, sizeof(this->chars));
+  }
+}
+
+LoxString::LoxString(LoxString &&o)
+    : length(o.length), hash_value(o.hash_value), heap(o.heap) {
+  memcpy(this->chars, o.chars, sizeof(this->chars));
+  o.length = 0;
+  o.hash_value = 0;
+  o.heap = false;
+  o.chars[0] = '\0';
+}
+
+LoxString &LoxString::operator=(const LoxString &o) {
+  if (this != &o) {
+    LoxString copy(o);
+    *this = std::move(copy);
+  }
+  return *this;
+}
+
+LoxString &LoxString::operator=(LoxString &&o) {
+  if (this != &o) {
+    if (this->heap) {
+      release(this->node);
+    }
+    this->length = o.length;
+    this->hash_value = o.hash_value;
+    this->heap = o.heap;
+    memcpy(this->chars, o.chars, sizeof(this->chars));
+    o.length = 0;
+    o.hash_value = 0;
+    o.heap = false;
+    o.chars[0] = '\0';
+  }
+  return *this;
+}
+
+LoxString::~LoxString() {
+  if (this->heap) {
+    release(this->node);
+  }
+}
+
+void LoxString::release(Node *node) {
+  if (--node->refs > 0) {
+    return;
+  }
+  std::vector<Node *> dead(1, node);
+  while (!dead.empty()) {
+    Node *n = dead.back();
+    dead.pop_back();
+    // unhook the halves first, so deleting n does not recurse into them
+    for (LoxString *half : {&n->left, &n->right}) {
+      if (half->heap) {
+        if (--half->node->refs == 0) {
+          dead.push_back(half->node);
+        }
+        half->heap = false;
+        half->length = 0;
+      }
+    }
+    ::operator delete(n->text);
+    delete n;
+  }
+}
+
+void LoxString::flatten(Node *node) {
+  if (node->text != nullptr) {
+    return;
+  }
+  std::size_t size = node->left.length + node->right.length;
+  HeapProfile::Site site(HeapProfile::STRING);
+  char *text = alloc_text(size);
+  std::size_t pos = 0;
+
+  // left to right, the pending right halves wait on the stack
+  std::vector<const LoxString *> todo = {&node->right, &node->left};
+  while (!todo.empty()) {
+    const LoxString *s = todo.back();
+    todo.pop_back();
+    if (!s->heap) {
+      memcpy(text + pos, s->chars, s->length);
+      pos += s->length;
+    } else if (s->node->text != nullptr) {
+      memcpy(text + pos, s->node->text, s->length);
+      pos += s->length;
+    } else {
+      todo.push_back(&s->node->right);
+      todo.push_back(&s->node->left);
+    }
+  }
+
+  node->text = text;
+  node->used = node->capacity = size;
+  node->left = LoxString();
+  node->right = LoxString();
+}
+
+bool LoxString::is_rope() const {
+  return this->heap && this->node->text == nullptr;
+}
+
+const char *LoxString::data() const {
+  if (!this->heap) {
+    return this->chars;
+  }
+  flatten(this->node);
+  return this->node->text;
+}
+
+std::uint32_t LoxString::hash() const {
+  if (this->hash_value == 0) {
+    const char *p = this->data();
+    std::uint32_t h = 2166136261u;
+    for (std::size_t i = 0; i < this->length; i++) {
+      h = (h ^ static_cast<unsigned char>(p[i])) * 16777619u;
+    }
+    // 0 means not computed yet
+    this->hash_value = h ? h : 1;
+  }
+  return this->hash_value;
+}
+
+bool LoxString::operator==(const LoxString &o) const {
+  if (this->length != o.length) {
+    return false;
+  }
+  if (this->hash_value && o.hash_value && this->hash_value != o.hash_value) {
+    return false;
+  }
+  // same length on the same node is the same prefix
+  if (this->heap && o.heap && this->node == o.node) {
+    return true;
+  }
+  return memcmp(this->data(), o.data(), this->length) == 0;
+}
+
+LoxString operator+(const LoxString &a, const LoxString &b) {
+  if (b.length == 0) {
+    return a;
+  }
+  if (a.length == 0) {
+    return b;
+  }
+  std::size_t total = a.length + b.length;
+  if (b.is_rope()) {
+    // stays lazy, and is long enough not to be worth copying anyway
+    return LoxString(LoxString::new_rope(a, b), total);
+  }
+  const char *tail = b.data();
+
+  if (total <= LoxString::INLINE_SIZE) {
+    LoxString r;
+    memcpy(r.chars, a.data(), a.length);
+    memcpy(r.chars + a.length, tail, b.length);
+    r.chars[total] = '\0';
+    r.length = total;
+    return r;
+  }
+
+  // a ends where its node does, the room behind it is free to use. b may
+  // even be a prefix of the same node, the copy never overlaps.
+  if (a.heap) {
+    LoxString::Node *n = a.node;
+    if (n->text != nullptr && a.length == n->used &&
+        n->capacity - n->used >= b.length) {
+      memcpy(n->text + n->used, tail, b.length);
+      n->used += b.length;
+      return LoxString(n, total);
+    }
+    // the same one level down, into the last leaf of a rope
+    const LoxString &last = n->right;
+    if (n->text == nullptr && last.heap && last.node->text != nullptr &&
+        last.length == last.node->used &&
+        last.node->capacity - last.node->used >= b.length) {
+      LoxString::Node *leaf = last.node;
+      memcpy(leaf->text + leaf->used, tail, b.length);
+      leaf->used += b.length;
+
+      return LoxString(LoxString::new_rope(
+                           n->left, LoxString(leaf, last.length + b.length)),
+                       total);
+    }
+  }
+
+  if (total < ROPE_MIN) {
+    LoxString::Node *n = LoxString::new_flat(2 * total);
+    memcpy(n->text, a.data(), a.length);
+    memcpy(n->text + a.length, tail, b.length);
+    n->used = total;
+    return LoxString(n, total);
+  }
+
+  if (b.length >= CHUNK) {
+    return LoxString(LoxString::new_rope(a, b), total);
+  }
+  // a leaf with room, so the appends that follow land in it
+  LoxString::Node *leaf = LoxString::new_flat(CHUNK);
+  memcpy(leaf->text, tail, b.length);
+  leaf->used = b.length;
+  return LoxString(LoxString::new_rope(a, LoxString(leaf, b.length)), total);
+}
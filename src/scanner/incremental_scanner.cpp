@@ -0,0 +1,146 @@
+#include "incremental_scanner.h"
+#include "number.h"
+#include "scanner.h"
+#include "token.h"
+#include <algorithm>
+#include <string>
+
+IncrementalScanner::IncrementalScanner(const std::string &source)
+    : source(source), lines(1), gap_begin(0), gap_end(0) {
+  this->lines += std::count(source.begin(), source.end(), '\n');
+  this->rescan(0);
+}
+
+void IncrementalScanner::move_gap(std::size_t i) {
+  std::size_t size = this->source.size();
+  // tokens in front of the gap move behind it
+  while (this->gap_begin > i) {
+    Span s = this->spans[--this->gap_begin];
+    s.start = size - s.start;
+    s.line = this->lines - s.line;
+    this->spans[--this->gap_end] = s;
+  }
+  // and the other way round
+  while (this->gap_begin < i) {
+    Span s = this->spans[this->gap_end++];
+    s.start = size - s.start;
+    s.line = this->lines - s.line;
+    this->spans[this->gap_begin++] = s;
+  }
+}
+
+void IncrementalScanner::push(const Span &s) {
+  if (this->gap_begin == this->gap_end) {
+    std::size_t grow = std::max<std::size_t>(64, this->spans.size());
+    this->spans.insert(this->spans.begin() + this->gap_begin, grow, Span());
+    this->gap_end += grow;
+  }
+  this->spans[this->gap_begin++] = s;
+}
+
+std::size_t IncrementalScanner::line_at(std::size_t pos) const {
+  std::size_t from = 0, line = 1;
+  if (this->gap_begin > 0) {
+    const Span &prev = this->spans[this->gap_begin - 1];
+    from = prev.start;
+    line = prev.line;
+  }
+  return line + std::count(this->source.begin() + from,
+                           this->source.begin() + pos, '\n');
+}
+
+std::size_t IncrementalScanner::first_touching(std::size_t pos) const {
+  std::size_t lo = 0, hi = this->size();
+  while (lo < hi) {
+    std::size_t mid = lo + (hi - lo) / 2;
+    Span s = this->span(mid);
+    if (s.start + s.length < pos) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+void IncrementalScanner::rescan(std::size_t pos) {
+  std::size_t size = this->source.size();
+  std::size_t base_line = this->line_at(pos);
+  Scanner sc(this->source.data() + pos, size - pos);
+
+  while (true) {
+    Token &t = sc.next_token();
+    if (t.getType() == tok_eof) {
+      // nothing left to line up with
+      this->gap_end = this->spans.size();
+      return;
+    }
+
+    std::size_t start = pos + t.getOffset() - 1;
+    // drop the old tokens this one has run over
+    while (this->gap_end < this->spans.size() &&
+           size - this->spans[this->gap_end].start < start) {
+      this->gap_end++;
+    }
+    // The old token starts right here, and the text from here on did not
+    // change, so the rest of the old tokens are still right
+    if (this->gap_end < this->spans.size() &&
+        size - this->spans[this->gap_end].start == start) {
+      return;
+    }
+
+    std::size_t length = t.getLexeme().size();
+    if (t.getType() == tok_string) {
+      // the quotes are not part of the lexeme
+      length += 2;
+    }
+    this->push({t.getType(), start, base_line + t.getLine() - 1, length});
+  }
+}
+
+void IncrementalScanner::edit(std::size_t offset, std::size_t removed,
+                              const std::string &inserted) {
+  offset = std::min(offset, this->source.size());
+  removed = std::min(removed, this->source.size() - offset);
+
+  // A token that ends right at the edit can grow into it ("ab" + "c"), so
+  // restart at the first token that touches it
+  std::size_t first = this->first_touching(offset);
+  std::size_t restart = offset;
+  if (first < this->size()) {
+    restart = std::min(restart, this->span(first).start);
+  }
+  this->move_gap(first);
+
+  // Old tokens overlapping the removed text can never be reused
+  std::size_t size = this->source.size();
+  while (this->gap_end < this->spans.size() &&
+         size - this->spans[this->gap_end].start < offset + removed) {
+    this->gap_end++;
+  }
+
+  this->lines -= std::count(this->source.begin() + offset,
+                            this->source.begin() + offset + removed, '\n');
+  this->lines += std::count(inserted.begin(), inserted.end(), '\n');
+  this->source.replace(offset, removed, inserted);
+
+  this->rescan(restart);
+}
+
+Token IncrementalScanner::get_token(std::size_t i) const {
+  Span s = this->span(i);
+  std::size_t line_start = 0;
+  if (s.start > 0) {
+    std::size_t nl = this->source.rfind('\n', s.start - 1);
+    if (nl != std::string::npos) {
+      line_start = nl + 1;
+    }
+  }
+
+  std::string lexeme = s.type == tok_string
+                           ? this->source.substr(s.start + 1, s.length - 2)
+                           : this->source.substr(s.start, s.length);
+  double number = s.type == tok_number ? NumberLiteral::parse(lexeme) : 0;
+  return Token(s.type, s.line, s.start - line_start + 1, s.start + 1, lexeme,
+               number);
+}
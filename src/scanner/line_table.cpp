@@ -0,0 +1,35 @@
+#include "line_table.h"
+#include <algorithm>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+void LineTable::add(const char *data, std::size_t size) {
+  std::size_t i = 0;
+#if defined(__SSE2__)
+  // 16 bytes a compare. Lines are short, so this beats a memchr call per
+  // newline; every newline of a block comes out of its mask.
+  const __m128i nl = _mm_set1_epi8('\n');
+  for (; i + 16 <= size; i += 16) {
+    __m128i block =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+    unsigned mask = _mm_movemask_epi8(_mm_cmpeq_epi8(block, nl));
+    while (mask) {
+      this->starts.push_back(this->size + i + __builtin_ctz(mask) + 1);
+      mask &= mask - 1;
+    }
+  }
+#endif
+  for (; i < size; i++) {
+    if (data[i] == '\n') {
+      this->starts.push_back(this->size + i + 1);
+    }
+  }
+  this->size += size;
+}
+
+std::size_t LineTable::search(std::size_t pos) const {
+  // the first line starting after pos is the one after it
+  return std::upper_bound(this->starts.begin(), this->starts.end(), pos) -
+         this->starts.begin();
+}
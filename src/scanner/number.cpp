@@ -0,0 +1,78 @@
+#include "number.h"
+#include <cfloat>
+#include <clocale>
+#include <cstdint>
+#include <cstdlib>
+#include <locale.h>
+#include <string>
+
+namespace {
+// Every power of ten up to 10^22 is an exact double
+const double powers[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+                         1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+                         1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+const int MAX_POWER = 22;
+const std::uint64_t MAX_EXACT = std::uint64_t(1) << 53;
+
+// strtod follows LC_NUMERIC, a literal is always written with a '.'
+locale_t c_locale() {
+  static locale_t c = newlocale(LC_ALL_MASK, "C", (locale_t)0);
+  return c;
+}
+} // namespace
+
+bool NumberLiteral::fast_value(double &value) const {
+#if FLT_EVAL_METHOD != 0
+  // excess precision (x87) rounds twice, the shortcut is not exact there
+  return false;
+#endif
+  if (this->truncated || this->mantissa > MAX_EXACT) {
+    return false;
+  }
+  double m = static_cast<double>(this->mantissa);
+  if (this->mantissa == 0 || this->exponent == 0) {
+    value = m;
+    return true;
+  }
+  if (this->exponent < 0) {
+    if (this->exponent < -MAX_POWER) {
+      return false;
+    }
+    value = m / powers[-this->exponent];
+    return true;
+  }
+  // a big exponent on a short mantissa ("12" followed by 30 zeros): move
+  // zeros into the mantissa while it stays exact
+  std::uint64_t scaled = this->mantissa;
+  int e = this->exponent;
+  while (e > MAX_POWER) {
+    if (scaled > MAX_EXACT / 10) {
+      return false;
+    }
+    scaled *= 10;
+    e--;
+  }
+  value = static_cast<double>(scaled) * powers[e];
+  return true;
+}
+
+double NumberLiteral::value(const std::string &lexeme) const {
+  double v;
+  if (this->fast_value(v)) {
+    return v;
+  }
+  return strtod_l(lexeme.c_str(), nullptr, c_locale());
+}
+
+double NumberLiteral::parse(const std::string &lexeme) {
+  NumberLiteral lit;
+  bool fraction = false;
+  for (char c : lexeme) {
+    if (c == '.') {
+      fraction = true;
+    } else {
+      lit.push_digit(c - '0', fraction);
+    }
+  }
+  return lit.value(lexeme);
+}
@@ -0,0 +1,118 @@
+#include "prefetcher.h"
+#include <cerrno>
+#include <cstdio>
+#include <fcntl.h>
+#include <cstdlib>
+#include <mutex>
+#include <poll.h>
+#include <unistd.h>
+
+Prefetcher::Prefetcher(int fd)
+    : fd(fd), filled(0), released(0), holding(false), stopping(false) {
+  for (std::size_t i = 0; i < SLOTS; i++) {
+    this->slots[i].data = (char *)malloc(SLOT_SIZE + 1);
+    this->slots[i].size = 0;
+    if (this->slots[i].data == nullptr) {
+      fprintf(stderr, "Unable to allocate memory for file buffer\n");
+      exit(EXIT_FAILURE);
+    }
+  }
+  if (pipe2(this->wake, O_CLOEXEC) != 0) {
+    fprintf(stderr, "Unable to create pipe for file prefetch\n");
+    exit(EXIT_FAILURE);
+  }
+  this->reader = std::thread(&Prefetcher::run, this);
+}
+
+Prefetcher::~Prefetcher() {
+  this->cancel();
+  this->reader.join();
+  close(this->wake[0]);
+  close(this->wake[1]);
+  for (std::size_t i = 0; i < SLOTS; i++) {
+    free(this->slots[i].data);
+  }
+}
+
+void Prefetcher::cancel() {
+  {
+    std::lock_guard<std::mutex> l(this->lock);
+    if (this->stopping) {
+      return;
+    }
+    this->stopping = true;
+  }
+  this->cv.notify_all();
+  // the reader may be in poll(), with nothing to read for a long time
+  char c = 0;
+  while (write(this->wake[1], &c, 1) == -1 && errno == EINTR) {
+  }
+}
+
+void Prefetcher::run() {
+  while (true) {
+    Slot *slot;
+    {
+      // wait for a free slot
+      std::unique_lock<std::mutex> l(this->lock);
+      this->cv.wait(l, [this] {
+        return this->stopping || this->filled - this->released < SLOTS;
+      });
+      if (this->stopping) {
+        return;
+      }
+      slot = &this->slots[this->filled % SLOTS];
+    }
+
+    // Wait for input or for cancel(), so a reader with nothing to read
+    // never keeps the File from going away
+    struct pollfd p[2] = {{this->fd, POLLIN, 0}, {this->wake[0], POLLIN, 0}};
+    int ready = poll(p, 2, -1);
+    if (ready == -1 && errno == EINTR) {
+      continue;
+    }
+    if (p[1].revents) {
+      return;
+    }
+
+    ssize_t n;
+    do {
+      n = read(this->fd, slot->data, SLOT_SIZE);
+    } while (n == -1 && errno == EINTR);
+    slot->size = n;
+
+    {
+      std::lock_guard<std::mutex> l(this->lock);
+      this->filled++;
+    }
+    this->cv.notify_all();
+    if (n <= 0) {
+      return;
+    }
+  }
+}
+
+ssize_t Prefetcher::next(char **data) {
+  std::unique_lock<std::mutex> l(this->lock);
+  if (this->holding) {
+    this->released++;
+    this->holding = false;
+    this->cv.notify_all();
+  }
+  this->cv.wait(l, [this] {
+    return this->filled > this->released || this->stopping;
+  });
+  if (this->filled == this->released) {
+    // cancelled, and nothing left that was read before
+    return 0;
+  }
+
+  Slot &slot = this->slots[this->released % SLOTS];
+  if (slot.size <= 0) {
+    // EOF and errors are sticky, the slot is never handed back
+    return slot.size;
+  }
+  this->holding = true;
+  *data = slot.data;
+  return slot.size;
+}
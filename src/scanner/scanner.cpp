@@ -1,11 +1,17 @@
 #include "scanner.h"
+#include "heap_profile.h"
+#include "number.h"
+#include "stats.h"
 #include "token.h"
+#include <algorithm>
 #include <cctype>
 #include <cstdlib>
 #include <cstring>
 #include <fcntl.h>
 #include <iostream>
 #include <ostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <unistd.h>
 #include <unordered_map>
 
@@ -19,147 +25,114 @@ const static std::unordered_map<std::string, TokenType> keywords = {
     {"list", tok_list},   {"print", tok_print}};
 }
 
-std::ostream &operator<<(std::ostream &out, const TokenType &t) {
-  switch (t) {
-  case tok_eof:
-    out << "EOF";
-    break;
-  case tok_lbrace:
-    out << "LBRACE";
-    break;
-  case tok_rbrace:
-    out << "RBRACE";
-    break;
-  case tok_lparen:
-    out << "LPAREN";
-    break;
-  case tok_rparen:
-    out << "RPAREN";
-    break;
-  case tok_lbracket:
-    out << "LBRACKET";
-    break;
-  case tok_rbracket:
-    out << "RBRACKET";
-    break;
-  case tok_comma:
-    out << "COMMA";
-    break;
-  case tok_dot:
-    out << "DOT";
-    break;
-  case tok_colon:
-    out << "COLON";
-    break;
-  case tok_semicolon:
-    out << "SEMICOLON";
-    break;
-  case tok_plus:
-    out << "PLUS";
-    break;
-  case tok_minus:
-    out << "MINUS";
-    break;
-  case tok_star:
-    out << "STAR";
-    break;
-  case tok_slash:
-    out << "SLASH";
-    break;
-  case tok_not:
-    out << "NOT";
-    break;
-  case tok_assign:
-    out << "ASSIGN";
-    break;
-  case tok_lt:
-    out << "LT";
-    break;
-  case tok_gt:
-    out << "GT";
-    break;
-  case tok_ge:
-    out << "GE";
-    break;
-  case tok_le:
-    out << "LE";
-    break;
-  case tok_eq:
-    out << "EQ";
-    break;
-  case tok_ne:
-    out << "NE";
-    break;
-  case tok_ident:
-    out << "IDENT";
-    break;
-  case tok_number:
-    out << "NUMBER";
-    break;
-  case tok_string:
-    out << "STRING";
-    break;
-  case tok_and:
-    out << "AND";
-    break;
-  case tok_class:
-    out << "CLASS";
-    break;
-  case tok_else:
-    out << "ELSE";
-    break;
-  case tok_false:
-    out << "FALSE";
-    break;
-  case tok_func:
-    out << "FUNC";
-    break;
-  case tok_for:
-    out << "FOR";
-    break;
-  case tok_if:
-    out << "IF";
-    break;
-  case tok_nil:
-    out << "NIL";
-    break;
-  case tok_or:
-    out << "OR";
-    break;
-  case tok_return:
-    out << "RETURN";
-    break;
-  case tok_super:
-    out << "SUPER";
-    break;
-  case tok_this:
-    out << "THIS";
-    break;
-  case tok_true:
-    out << "TRUE";
-    break;
-  case tok_var:
-    out << "VAR";
-    break;
-  case tok_while:
-    out << "WHILE";
-    break;
-  case tok_list:
-    out << "LIST";
-    break;
-  case tok_print:
-    out << "PRINT";
-    break;
-  default:
-    out << "UNKNOWN";
-    break;
+TokenType keyword_type(const std::string &lexeme) {
+  auto it = keywords.find(lexeme);
+  if (it != keywords.end()) {
+    return it->second;
+  }
+  return tok_ident;
+}
+
+namespace {
+// Names of tok_lparen .. tok_print, in enum order
+const char *const token_names[] = {
+    "LPAREN", // tok_lparen
+    "RPAREN", // tok_rparen
+    "LBRACKET", // tok_lbracket
+    "RBRACKET", // tok_rbracket
+    "LBRACE", // tok_lbrace
+    "RBRACE", // tok_rbrace
+    "COMMA", // tok_comma
+    "DOT", // tok_dot
+    "COLON", // tok_colon
+    "SEMICOLON", // tok_semicolon
+    "PLUS", // tok_plus
+    "MINUS", // tok_minus
+    "STAR", // tok_star
+    "SLASH", // tok_slash
+    "NOT", // tok_not
+    "ASSIGN", // tok_assign
+    "LT", // tok_lt
+    "GT", // tok_gt
+    "GE", // tok_ge
+    "LE", // tok_le
+    "EQ", // tok_eq
+    "NE", // tok_ne
+    "IDENT", // tok_ident
+    "NUMBER", // tok_number
+    "STRING", // tok_string
+    "AND", // tok_and
+    "CLASS", // tok_class
+    "ELSE", // tok_else
+    "FALSE", // tok_false
+    "FUNC", // tok_func
+    "FOR", // tok_for
+    "IF", // tok_if
+    "NIL", // tok_nil
+    "OR", // tok_or
+    "RETURN", // tok_return
+    "SUPER", // tok_super
+    "THIS", // tok_this
+    "TRUE", // tok_true
+    "VAR", // tok_var
+    "WHILE", // tok_while
+    "LIST", // tok_list
+    "PRINT", // tok_print
+};
+// A token added to the enum without a name here would shift the names of
+// every token after it
+static_assert(sizeof(token_names) / sizeof(token_names[0]) ==
+                  tok_print - tok_lparen + 1,
+              "token_names must name every token from tok_lparen to tok_print");
+} // namespace
+
+const char *token_type_name(TokenType t) {
+  if (t == tok_eof) {
+    return "EOF";
+  }
+  if (t == tok_error) {
+    return "ERROR";
   }
+  std::size_t i = t - tok_lparen;
+  if (t < tok_lparen || i >= sizeof(token_names) / sizeof(token_names[0])) {
+    return "UNKNOWN";
+  }
+  return token_names[i];
+}
+
+std::ostream &operator<<(std::ostream &out, const TokenType &t) {
+  out << token_type_name(t);
   return out;
 }
 
 void File::read_a_chunk() {
+  Stats::Scope phase(Stats::READ);
+  this->base += this->end - this->chunk;
   // Read a chunk of data from the file
-  ssize_t bytes_read = read(this->fd, this->buffer, this->buffer_size - 1);
+  ssize_t bytes_read;
+  // in memory, data may well be null when size is 0
+  if (this->fd == -1) {
+    bytes_read = std::min(this->buffer_size - 1,
+                          this->memory_size - this->memory_pos);
+    if (bytes_read > 0) {
+      memcpy(this->buffer, this->memory + this->memory_pos, bytes_read);
+      this->memory_pos += bytes_read;
+    }
+  } else if (this->prefetch) {
+    // Scan the prefetched chunk in place, it has room for the terminator
+    char *chunk;
+    bytes_read = this->prefetch->next(&chunk);
+    if (bytes_read > 0) {
+      this->chunk = chunk;
+      this->current = chunk;
+      this->end = chunk + bytes_read;
+      *(this->end) = '\0';
+      this->lines.add(chunk, bytes_read);
+      return;
+    }
+  } else {
+    bytes_read = read(this->fd, this->buffer, this->buffer_size - 1);
+  }
   if (bytes_read == -1) {
     // Error
     fprintf(stderr, "Unable to read from file %s\n", this->filename.c_str());
@@ -168,25 +141,23 @@ void File::read_a_chunk() {
   if (bytes_read == 0) {
     // EOF, clean up
     memset(this->buffer, 0, this->buffer_size);
+    this->chunk = this->buffer;
     this->current = this->buffer;
     this->end = this->buffer;
-    *(this->current) = EOF;
+    this->done = true;
     return;
   }
 
+  this->chunk = this->buffer;
   this->current = this->buffer;
   this->end = this->buffer + bytes_read;
   // Add \00 to the end of the buffer
   *(this->end) = '\0';
+  this->lines.add(this->buffer, bytes_read);
 }
 
-char File::next_char() {
-  if (this->newline) {
-    this->update_pos(this->newline);
-    this->newline = false;
-  }
-
-  if (this->buffer_empty() && !this->eof()) {
+int File::next_char_slow() {
+  if (!this->eof()) {
     this->read_a_chunk();
   }
 
@@ -194,33 +165,66 @@ char File::next_char() {
     return EOF;
   }
 
-  char c = *(this->current);
-  this->current++;
-  this->update_pos();
+  return static_cast<unsigned char>(*(this->current++));
+}
+
+// return the current character without moving the file pointer
+char File::peek() const { return *(this->current); }
+
+int MemoryInput::next_char_slow(unsigned char c) {
   if (c == '\n') {
-    this->newline = true;
+    // counted right away, nothing asks for the position of a '\n'
+    this->line++;
+    this->line_start = this->current;
+  } else if (c == '\0' && this->current > this->end) {
+    // the terminator, stay on it so every later call ends up here again
+    this->current = this->end;
+    this->done = true;
+    return EOF;
   }
-
   return c;
 }
 
-void File::update_pos(bool newline) {
-  if (newline) {
-    if (this->is_from_file())
-      this->line++;
-    this->column = 0;
-  } else {
-    this->column++;
+MappedInput::MappedInput(const std::string &filename)
+    : MemoryInput(nullptr, 0, filename), map(nullptr), map_size(0) {
+  // Mapping the file is its read phase. The pages are faulted in as the
+  // scanner gets to them, which counts as lexing.
+  Stats::Scope phase(Stats::READ);
+  int fd = open(filename.c_str(), O_RDONLY);
+  struct stat st;
+  if (fd == -1 || fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+    fprintf(stderr, "Unable to map file %s\n", filename.c_str());
+    exit(EXIT_FAILURE);
   }
-  this->offset++;
-}
 
-// return the current character without moving the file pointer
-char File::peek() const { return *(this->current); }
+  std::size_t size = st.st_size;
+  if (size > 0) {
+    std::size_t page = sysconf(_SC_PAGESIZE);
+    this->map_size = (size / page + 1) * page;
+    // Reserve zero pages first and map the file over their start. The rest
+    // of the file's last page reads as zero too.
+    void *p = mmap(nullptr, this->map_size, PROT_READ,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED ||
+        mmap(p, size, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0) ==
+            MAP_FAILED) {
+      fprintf(stderr, "Unable to map file %s\n", filename.c_str());
+      exit(EXIT_FAILURE);
+    }
+    madvise(p, size, MADV_SEQUENTIAL);
+    this->map = p;
+    this->reset(static_cast<const char *>(p), size);
+  }
+  close(fd);
+}
 
-int Scanner::get_char() { return this->f->next_char(); }
+MappedInput::~MappedInput() {
+  if (this->map) {
+    munmap(this->map, this->map_size);
+  }
+}
 
-Token &Scanner::next_token() {
+template <class Input> Token &BasicScanner<Input>::next_token() {
   if (this->stop) {
     this->stop = false;
     return this->peek_token();
@@ -228,11 +232,17 @@ Token &Scanner::next_token() {
   while (isspace(this->lastchar)) {
     this->lastchar = this->get_char();
   }
+  // Where the token starts, looked up once in the line table. Every branch
+  // below takes its position from here.
+  std::size_t line, column;
+  this->in.get_position(line, column);
+  std::size_t offset = this->in.get_offset();
+  // lexemes and history growth, on the line the token starts on
+  HeapProfile::Site site(HeapProfile::TOKEN, line);
 
   if (this->lastchar == EOF &&
       (this->tokens.empty() || this->tokens.back().getType() != tok_eof)) {
-    Token e = Token(tok_eof, this->f->get_line(), this->f->get_column(),
-                    this->f->get_offset());
+    Token e = Token(tok_eof, line, column, offset);
     this->tokens.push_back(e);
     return this->tokens.back();
   }
@@ -242,108 +252,91 @@ Token &Scanner::next_token() {
   }
 
   if (this->lastchar == '{') {
-    Token e = Token(tok_lbrace, this->f->get_line(), this->f->get_column(),
-                    this->f->get_offset(), "{");
+    Token e = Token(tok_lbrace, line, column, offset, "{");
     this->tokens.push_back(e);
     this->lastchar = this->get_char();
     return this->tokens.back();
   }
   if (this->lastchar == '}') {
-    Token e = Token(tok_rbrace, this->f->get_line(), this->f->get_column(),
-                    this->f->get_offset(), "}");
+    Token e = Token(tok_rbrace, line, column, offset, "}");
     this->tokens.push_back(e);
     this->lastchar = this->get_char();
     return this->tokens.back();
   }
   if (this->lastchar == '(') {
-    Token e = Token(tok_lparen, this->f->get_line(), this->f->get_column(),
-                    this->f->get_offset(), "(");
+    Token e = Token(tok_lparen, line, column, offset, "(");
     this->tokens.push_back(e);
     this->lastchar = this->get_char();
     return this->tokens.back();
   }
   if (this->lastchar == ')') {
-    Token e = Token(tok_rparen, this->f->get_line(), this->f->get_column(),
-                    this->f->get_offset(), ")");
+    Token e = Token(tok_rparen, line, column, offset, ")");
     this->tokens.push_back(e);
     this->lastchar = this->get_char();
     return this->tokens.back();
   }
   if (this->lastchar == '[') {
-    Token e = Token(tok_lbracket, this->f->get_line(), this->f->get_column(),
-                    this->f->get_offset(), "[");
+    Token e = Token(tok_lbracket, line, column, offset, "[");
     this->tokens.push_back(e);
     this->lastchar = this->get_char();
     return this->tokens.back();
   }
   if (this->lastchar == ']') {
-    Token e = Token(tok_rbracket, this->f->get_line(), this->f->get_column(),
-                    this->f->get_offset(), "]");
+    Token e = Token(tok_rbracket, line, column, offset, "]");
     this->tokens.push_back(e);
     this->lastchar = this->get_char();
     return this->tokens.back();
   }
   if (this->lastchar == ',') {
-    Token e = Token(tok_comma, this->f->get_line(), this->f->get_column(),
-                    this->f->get_offset(), ",");
+    Token e = Token(tok_comma, line, column, offset, ",");
     this->tokens.push_back(e);
     this->lastchar = this->get_char();
     return this->tokens.back();
   }
   if (this->lastchar == '.') {
-    Token e = Token(tok_dot, this->f->get_line(), this->f->get_column(),
-                    this->f->get_offset(), ".");
+    Token e = Token(tok_dot, line, column, offset, ".");
     this->tokens.push_back(e);
     this->lastchar = this->get_char();
     return this->tokens.back();
   }
   if (this->lastchar == ':') {
-    Token e = Token(tok_colon, this->f->get_line(), this->f->get_column(),
-                    this->f->get_offset(), ":");
+    Token e = Token(tok_colon, line, column, offset, ":");
     this->tokens.push_back(e);
     this->lastchar = this->get_char();
     return this->tokens.back();
   }
   if (this->lastchar == ';') {
-    Token e = Token(tok_semicolon, this->f->get_line(), this->f->get_column(),
-                    this->f->get_offset(), ";");
+    Token e = Token(tok_semicolon, line, column, offset, ";");
     this->tokens.push_back(e);
     this->lastchar = this->get_char();
     return this->tokens.back();
   }
   if (this->lastchar == '+') {
-    Token e = Token(tok_plus, this->f->get_line(), this->f->get_column(),
-                    this->f->get_offset(), "+");
+    Token e = Token(tok_plus, line, column, offset, "+");
     this->tokens.push_back(e);
     this->lastchar = this->get_char();
     return this->tokens.back();
   }
   if (this->lastchar == '-') {
-    Token e = Token(tok_minus, this->f->get_line(), this->f->get_column(),
-                    this->f->get_offset(), "-");
+    Token e = Token(tok_minus, line, column, offset, "-");
     this->tokens.push_back(e);
     this->lastchar = this->get_char();
     return this->tokens.back();
   }
   if (this->lastchar == '*') {
-    Token e = Token(tok_star, this->f->get_line(), this->f->get_column(),
-                    this->f->get_offset(), "*");
+    Token e = Token(tok_star, line, column, offset, "*");
     this->tokens.push_back(e);
     this->lastchar = this->get_char();
     return this->tokens.back();
   }
   if (this->lastchar == '/') {
-    Token e = Token(tok_slash, this->f->get_line(), this->f->get_column(),
-                    this->f->get_offset(), "/");
+    Token e = Token(tok_slash, line, column, offset, "/");
     this->tokens.push_back(e);
     this->lastchar = this->get_char();
     return this->tokens.back();
   }
   if (this->lastchar == '!') {
     // Check for '!='
-    std::size_t line = this->f->get_line();
-    std::size_t column = this->f->get_column();
-    std::size_t offset = this->f->get_offset();
     this->lastchar = this->get_char();
     if (this->lastchar == '=') {
       Token e = Token(tok_ne, line, column, offset, "!=");
@@ -358,9 +351,6 @@ Token &Scanner::next_token() {
   }
   if (this->lastchar == '=') {
     // Check for '=='
-    std::size_t line = this->f->get_line();
-    std::size_t column = this->f->get_column();
-    std::size_t offset = this->f->get_offset();
     this->lastchar = this->get_char();
     if (this->lastchar == '=') {
       Token e = Token(tok_eq, line, column, offset, "==");
@@ -375,9 +365,6 @@ Token &Scanner::next_token() {
   }
   if (this->lastchar == '<') {
     // Check for '<='
-    std::size_t line = this->f->get_line();
-    std::size_t column = this->f->get_column();
-    std::size_t offset = this->f->get_offset();
     this->lastchar = this->get_char();
     if (this->lastchar == '=') {
       Token e = Token(tok_le, line, column, offset, "<=");
@@ -392,9 +379,6 @@ Token &Scanner::next_token() {
   }
   if (this->lastchar == '>') {
     // Check for '>='
-    std::size_t line = this->f->get_line();
-    std::size_t column = this->f->get_column();
-    std::size_t offset = this->f->get_offset();
     this->lastchar = this->get_char();
     if (this->lastchar == '=') {
       Token e = Token(tok_ge, line, column, offset, ">=");
@@ -409,11 +393,12 @@ Token &Scanner::next_token() {
   }
   if (this->lastchar == '"') {
     std::string lexeme = "";
-    std::size_t line = this->f->get_line();
-    std::size_t column = this->f->get_column();
-    std::size_t offset = this->f->get_offset();
     this->lastchar = this->get_char();
     while (this->lastchar != '"') {
+      if (this->lastchar == EOF) {
+        // keep the opening quote, the lexeme of an error is its source text
+        return this->error(line, column, offset, '"' + lexeme);
+      }
       lexeme += this->lastchar;
       this->lastchar = this->get_char();
     }
@@ -425,31 +410,25 @@ Token &Scanner::next_token() {
   // number
   if (std::isdigit(this->lastchar)) {
     std::string lexeme = "";
-    std::size_t line = this->f->get_line();
-    std::size_t column = this->f->get_column();
-    std::size_t offset = this->f->get_offset();
-    bool has_dot = false;
+    std::size_t dots = 0;
+    NumberLiteral value;
     while (std::isdigit(this->lastchar) || this->lastchar == '.') {
       if (this->lastchar == '.') {
-        if (has_dot) {
-          fprintf(stderr, "Invalid number format at line %lu, column %lu\n",
-                  line, column);
-          exit(EXIT_FAILURE);
-        }
-        has_dot = true;
+        dots++;
+      } else {
+        value.push_digit(this->lastchar - '0', dots > 0);
       }
       lexeme += this->lastchar;
       this->lastchar = this->get_char();
     }
 
-    // check for invalid number format
-    if (lexeme.back() == '.') {
-      fprintf(stderr, "Invalid number format at line %lu, column %lu\n", line,
-              column);
-      exit(EXIT_FAILURE);
+    // check for invalid number format, the whole run is skipped
+    if (dots > 1 || lexeme.back() == '.') {
+      return this->error(line, column, offset, lexeme);
     }
 
-    Token e = Token(tok_number, line, column, offset, lexeme);
+    Token e = Token(tok_number, line, column, offset, lexeme,
+                    value.value(lexeme));
     this->tokens.push_back(e);
     return this->tokens.back();
   }
@@ -457,35 +436,49 @@ Token &Scanner::next_token() {
   // identifier of keyword
   if (std::isalpha(this->lastchar) || this->lastchar == '_') {
     std::string lexeme = "";
-    std::size_t line = this->f->get_line();
-    std::size_t column = this->f->get_column();
-    std::size_t offset = this->f->get_offset();
     while (std::isalnum(this->lastchar) || this->lastchar == '_') {
       lexeme += this->lastchar;
       this->lastchar = this->get_char();
     }
-    auto it = keywords.find(lexeme);
-    if (it != keywords.end()) {
-      // keywords
-      Token e = Token(it->second, line, column, offset, lexeme);
-      this->tokens.push_back(e);
-
-    } else {
-      Token e = Token(tok_ident, line, column, offset, lexeme);
-      this->tokens.push_back(e);
-    }
+    Token e = Token(keyword_type(lexeme), line, column, offset, lexeme);
+    this->tokens.push_back(e);
     return this->tokens.back();
   }
 
   // unknown character
-  if (this->lastchar != EOF) {
-    fprintf(stderr, "Unknown character %c at line %lu, column %lu\n",
-            this->lastchar, this->f->get_line(), this->f->get_column());
-    exit(EXIT_FAILURE);
-  }
+  std::string lexeme(1, this->lastchar);
+  this->lastchar = this->get_char();
+  return this->error(line, column, offset, lexeme);
+}
+
+template <class Input>
+Token &BasicScanner<Input>::error(std::size_t line, std::size_t column,
+                                  std::size_t offset,
+                                  const std::string &lexeme) {
+  this->errors++;
+  this->tokens.push_back(Token(tok_error, line, column, offset, lexeme));
   return this->tokens.back();
 }
 
+std::string scan_error(const Token &t) {
+  const std::string &lexeme = t.getLexeme();
+  std::string what;
+  if (lexeme[0] == '"') {
+    what = "Unterminated string";
+  } else if (std::isdigit(static_cast<unsigned char>(lexeme[0]))) {
+    what = "Invalid number format";
+  } else {
+    what = "Unknown character " + lexeme;
+  }
+  return what + " at line " + std::to_string(t.getLine()) + ", column " +
+         std::to_string(t.getColumn());
+}
+
+// Every input the scanner is used with
+template Token &BasicScanner<File>::next_token();
+template Token &BasicScanner<MemoryInput>::next_token();
+template Token &BasicScanner<MappedInput>::next_token();
+
 std::ostream &operator<<(std::ostream &out, const Token &t) {
   out << "<Line: " << t.getLine() << ", Column: " << t.getColumn()
       << ", Offset: " << t.getOffset() << ", Type: " << t.getType()
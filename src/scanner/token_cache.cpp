@@ -0,0 +1,301 @@
+#include "token_cache.h"
+#include "number.h"
+#include "token.h"
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+constexpr char LOXC_MAGIC[4] = {'L', 'O', 'X', 'C'};
+
+// Read-only mapping of a whole file, unmapped when it goes out of scope
+class MappedFile {
+private:
+  void *data;
+  std::size_t size;
+
+public:
+  inline MappedFile(const std::string &filename) : data(nullptr), size(0) {
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd == -1) {
+      return;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+      void *p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (p != MAP_FAILED) {
+        this->data = p;
+        this->size = st.st_size;
+      }
+    }
+    close(fd);
+  }
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  inline ~MappedFile() {
+    if (this->data) {
+      munmap(this->data, this->size);
+    }
+  }
+
+  inline bool ok() const { return this->data != nullptr; }
+  inline const char *get_data() const {
+    return static_cast<const char *>(this->data);
+  }
+  inline std::size_t get_size() const { return this->size; }
+
+  // Hand the mapping over to the caller, who has to munmap() it
+  inline const char *release() {
+    const char *p = this->get_data();
+    this->data = nullptr;
+    return p;
+  }
+};
+
+inline std::size_t align8(std::size_t n) { return (n + 7) & ~std::size_t(7); }
+
+} // namespace
+
+std::string TokenCache::cache_path(const std::string &filename) {
+  // script.lox -> script.loxc, anything else gets the extension appended
+  if (filename.size() > 4 &&
+      filename.compare(filename.size() - 4, 4, ".lox") == 0) {
+    return filename + "c";
+  }
+  return filename + ".loxc";
+}
+
+bool TokenCache::source_key(const std::string &filename, std::uint64_t &hash,
+                            std::uint64_t &size) {
+  // an empty file hashes as empty, it can not be mapped
+  struct stat st;
+  if (stat(filename.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) {
+    return false;
+  }
+  if (st.st_size == 0) {
+    hash = TokenCache::hash(nullptr, 0);
+    size = 0;
+    return true;
+  }
+  MappedFile src(filename);
+  if (!src.ok()) {
+    return false;
+  }
+  hash = TokenCache::hash(src.get_data(), src.get_size());
+  size = src.get_size();
+  return true;
+}
+
+std::uint64_t TokenCache::hash(const void *data, std::size_t size) {
+  // Word-at-a-time multiply/xor hash, good enough to detect stale or
+  // damaged caches and fast enough to not show up in startup time
+  const unsigned char *p = static_cast<const unsigned char *>(data);
+  std::uint64_t h = 0x9e3779b97f4a7c15ULL ^ (size * 0xff51afd7ed558ccdULL);
+  std::size_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    std::uint64_t w;
+    memcpy(&w, p + i, sizeof(w));
+    h = (h ^ (w * 0x87c37b91114253d5ULL)) * 0x4cf5ad432745937fULL;
+    h ^= h >> 29;
+  }
+  for (; i < size; i++) {
+    h = (h ^ p[i]) * 0x100000001b3ULL;
+  }
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+  return h;
+}
+
+TokenCache::View::View(const std::string &filename)
+    : base(nullptr), map_size(0), recs(nullptr), strings(nullptr),
+      chars(nullptr), count(0) {
+  std::uint64_t source_hash, source_size;
+  if (!source_key(filename, source_hash, source_size)) {
+    return;
+  }
+
+  MappedFile cache(cache_path(filename));
+  if (!cache.ok() || cache.get_size() < sizeof(LoxcHeader)) {
+    return;
+  }
+
+  LoxcHeader header;
+  memcpy(&header, cache.get_data(), sizeof(header));
+  if (memcmp(header.magic, LOXC_MAGIC, sizeof(LOXC_MAGIC)) != 0 ||
+      header.version != VERSION || header.source_hash != source_hash ||
+      header.source_size != source_size) {
+    return;
+  }
+
+  // The counts are 32 bits, so the sections before chars can not wrap.
+  // chars_size is 64 bits and compared against what is left, a crafted
+  // size must not wrap the sum around to the file size.
+  std::size_t tokens_at = align8(sizeof(LoxcHeader));
+  std::size_t strings_at =
+      align8(tokens_at + sizeof(LoxcToken) * header.token_count);
+  std::size_t chars_at =
+      align8(strings_at + sizeof(LoxcString) * header.string_count);
+  if (chars_at > cache.get_size() ||
+      header.chars_size != cache.get_size() - chars_at) {
+    return;
+  }
+
+  const char *payload = cache.get_data() + tokens_at;
+  if (hash(payload, cache.get_size() - tokens_at) != header.checksum) {
+    return;
+  }
+
+  const LoxcToken *recs =
+      reinterpret_cast<const LoxcToken *>(cache.get_data() + tokens_at);
+  const LoxcString *strings =
+      reinterpret_cast<const LoxcString *>(cache.get_data() + strings_at);
+
+  // Check every index once here, so the accessors need no bounds checks
+  for (std::uint32_t i = 0; i < header.string_count; i++) {
+    if (strings[i].length > header.chars_size ||
+        strings[i].offset > header.chars_size - strings[i].length) {
+      return;
+    }
+  }
+  for (std::uint32_t i = 0; i < header.token_count; i++) {
+    if (recs[i].lexeme >= header.string_count) {
+      return;
+    }
+  }
+
+  this->map_size = cache.get_size();
+  this->base = cache.release();
+  this->recs = recs;
+  this->strings = strings;
+  this->chars = this->base + chars_at;
+  this->count = header.token_count;
+}
+
+TokenCache::View::~View() {
+  if (this->base) {
+    munmap(const_cast<char *>(this->base), this->map_size);
+  }
+}
+
+bool TokenCache::load(const std::string &filename, std::vector<Token> &tokens) {
+  View view(filename);
+  if (!view.ok()) {
+    return false;
+  }
+
+  tokens.clear();
+  tokens.reserve(view.size());
+  for (std::uint32_t i = 0; i < view.size(); i++) {
+    std::size_t length;
+    const char *chars = view.lexeme(i, length);
+    std::string lexeme(chars, length);
+    // numbers are not stored, they are quicker to parse again than to read
+    double number =
+        view.type(i) == tok_number ? NumberLiteral::parse(lexeme) : 0;
+    tokens.emplace_back(view.type(i), view.line(i), view.column(i),
+                        view.offset(i), lexeme, number);
+  }
+
+  return true;
+}
+
+bool TokenCache::store(const std::string &filename, std::uint64_t source_hash,
+                       std::uint64_t source_size,
+                       const std::vector<Token> &tokens) {
+  LoxcHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, LOXC_MAGIC, sizeof(LOXC_MAGIC));
+  header.version = VERSION;
+  // The key was taken before scanning. If the file changed since, the
+  // tokens may be of neither version and must not be keyed by either.
+  if (!source_key(filename, header.source_hash, header.source_size) ||
+      header.source_hash != source_hash || header.source_size != source_size) {
+    return false;
+  }
+  // Offsets, lines and columns are stored in 32 bits, and none of them is
+  // bigger than the source.
+  if (source_size > UINT32_MAX || tokens.size() > UINT32_MAX) {
+    return false;
+  }
+
+  // Intern lexemes, identifiers and punctuation repeat a lot
+  std::vector<LoxcToken> recs;
+  std::vector<LoxcString> strings;
+  std::string chars;
+  std::unordered_map<std::string, std::uint32_t> interned;
+  recs.reserve(tokens.size());
+  for (const Token &t : tokens) {
+    std::string lexeme = t.getLexeme();
+    auto it = interned.find(lexeme);
+    std::uint32_t index;
+    if (it != interned.end()) {
+      index = it->second;
+    } else {
+      index = strings.size();
+      strings.push_back({static_cast<std::uint32_t>(chars.size()),
+                         static_cast<std::uint32_t>(lexeme.size())});
+      chars += lexeme;
+      interned.emplace(std::move(lexeme), index);
+    }
+    recs.push_back({static_cast<std::int32_t>(t.getType()), index,
+                    static_cast<std::uint32_t>(t.getLine()),
+                    static_cast<std::uint32_t>(t.getColumn()),
+                    static_cast<std::uint32_t>(t.getOffset())});
+  }
+  if (chars.size() > UINT32_MAX) {
+    return false;
+  }
+  header.token_count = recs.size();
+  header.string_count = strings.size();
+  header.chars_size = chars.size();
+
+  // Lay the whole file out in memory, then checksum and write it in one go
+  std::size_t tokens_at = align8(sizeof(LoxcHeader));
+  std::size_t strings_at = align8(tokens_at + sizeof(LoxcToken) * recs.size());
+  std::size_t chars_at =
+      align8(strings_at + sizeof(LoxcString) * strings.size());
+  std::vector<char> out(chars_at + chars.size(), 0);
+  if (!recs.empty())
+    memcpy(out.data() + tokens_at, recs.data(),
+           sizeof(LoxcToken) * recs.size());
+  if (!strings.empty())
+    memcpy(out.data() + strings_at, strings.data(),
+           sizeof(LoxcString) * strings.size());
+  memcpy(out.data() + chars_at, chars.data(), chars.size());
+  header.checksum = hash(out.data() + tokens_at, out.size() - tokens_at);
+  memcpy(out.data(), &header, sizeof(header));
+
+  // Write to a private file and rename it over the cache, so concurrent
+  // processes never see a half written cache
+  std::string path = cache_path(filename);
+  std::string tmp = path + ".tmp." + std::to_string(getpid());
+  int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd == -1) {
+    return false;
+  }
+  std::size_t written = 0;
+  while (written < out.size()) {
+    ssize_t n = write(fd, out.data() + written, out.size() - written);
+    if (n <= 0) {
+      close(fd);
+      unlink(tmp.c_str());
+      return false;
+    }
+    written += n;
+  }
+  close(fd);
+  if (rename(tmp.c_str(), path.c_str()) != 0) {
+    unlink(tmp.c_str());
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,95 @@
+#include "token_pipeline.h"
+#include "scanner.h"
+#include "token.h"
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+namespace {
+// A side that finds the queue empty or full yields this many times before
+// it goes to sleep. The other side usually catches up within a few rounds,
+// a sleep and a wakeup per token would cost more than the lexing. Waiting
+// on slow input still ends up asleep within microseconds.
+const unsigned SPINS = 64;
+} // namespace
+
+TokenPipeline::TokenPipeline(const std::string &filename, std::size_t capacity)
+    : scanner(filename), queue(capacity), consumer_waiting(false),
+      producer_waiting(false), cancelled(false), finished(false),
+      last(tok_eof, 0, 0, 0) {
+  // started last, everything it touches is constructed by now
+  this->producer = std::thread(&TokenPipeline::produce, this);
+}
+
+TokenPipeline::~TokenPipeline() {
+  {
+    std::lock_guard<std::mutex> l(this->lock);
+    this->cancelled = true;
+  }
+  // the producer may be waiting on a full queue nobody drains any more, or
+  // in the Scanner for input that may never come
+  this->cv.notify_all();
+  this->scanner.cancel();
+  this->producer.join();
+}
+
+void TokenPipeline::notify(std::atomic<bool> &waiting) {
+  // Both sides exchange the flag, so one of them comes second: either the
+  // sleeper sees what was just pushed or popped, or this sees its flag.
+  // Clearing it makes one wakeup per sleep, not one per token until the
+  // sleeper gets to run.
+  if (waiting.exchange(false)) {
+    std::lock_guard<std::mutex> l(this->lock);
+    this->cv.notify_all();
+  }
+}
+
+void TokenPipeline::produce() {
+  this->scanner.scan([this](Token &t) {
+    for (unsigned spins = 0; !this->queue.try_push(std::move(t)); spins++) {
+      if (spins < SPINS) {
+        std::this_thread::yield();
+        continue;
+      }
+      std::unique_lock<std::mutex> l(this->lock);
+      if (this->cancelled) {
+        return false;
+      }
+      // armed again on every round, notify() clears it
+      this->producer_waiting.exchange(true);
+      if (this->queue.full()) {
+        this->cv.wait(l);
+      }
+      this->producer_waiting.store(false, std::memory_order_relaxed);
+    }
+    this->notify(this->consumer_waiting);
+    return true;
+  });
+}
+
+Token TokenPipeline::next_token() {
+  if (this->finished) {
+    return this->last;
+  }
+
+  Token t(tok_eof, 0, 0, 0);
+  for (unsigned spins = 0; !this->queue.try_pop(t); spins++) {
+    if (spins < SPINS) {
+      std::this_thread::yield();
+      continue;
+    }
+    std::unique_lock<std::mutex> l(this->lock);
+    this->consumer_waiting.exchange(true);
+    // the producer always ends with EOF, so there is no waiting forever
+    if (this->queue.empty()) {
+      this->cv.wait(l);
+    }
+    this->consumer_waiting.store(false, std::memory_order_relaxed);
+  }
+  this->notify(this->producer_waiting);
+  if (t.getType() == tok_eof) {
+    this->finished = true;
+    this->last = t;
+  }
+  return t;
+}
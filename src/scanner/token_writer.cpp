@@ -0,0 +1,92 @@
+#include "token_writer.h"
+#include "token.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+
+namespace {
+void write_all(int fd, const char *data, std::size_t size) {
+  while (size > 0) {
+    ssize_t n = ::write(fd, data, size);
+    if (n <= 0) {
+      fprintf(stderr, "Unable to write token output\n");
+      exit(EXIT_FAILURE);
+    }
+    data += n;
+    size -= n;
+  }
+}
+} // namespace
+
+TokenWriter::TokenWriter(int fd, Format format)
+    : fd(fd), format(format), buffer(nullptr), used(0) {
+  this->buffer = (char *)malloc(BUF_SIZE);
+  if (this->buffer == nullptr) {
+    fprintf(stderr, "Unable to allocate memory for token output\n");
+    exit(EXIT_FAILURE);
+  }
+}
+
+TokenWriter::~TokenWriter() {
+  this->flush();
+  free(this->buffer);
+}
+
+void TokenWriter::flush() {
+  write_all(this->fd, this->buffer, this->used);
+  this->used = 0;
+}
+
+void TokenWriter::put_slow(const char *s, std::size_t n) {
+  this->flush();
+  if (n >= BUF_SIZE) {
+    write_all(this->fd, s, n);
+    return;
+  }
+  memcpy(this->buffer, s, n);
+  this->used = n;
+}
+
+void TokenWriter::put_uint(std::size_t v) {
+  // digits come out backwards, build them at the end of a scratch buffer
+  char digits[20];
+  char *p = digits + sizeof(digits);
+  do {
+    *--p = '0' + v % 10;
+    v /= 10;
+  } while (v != 0);
+  this->put(p, digits + sizeof(digits) - p);
+}
+
+void TokenWriter::write(const Token &t) {
+  if (this->format == BINARY) {
+    BinaryToken rec;
+    rec.type = t.getType();
+    rec.length = t.getLexeme().size();
+    rec.offset = t.getOffset();
+    rec.line = t.getLine();
+    rec.column = t.getColumn();
+    this->put(reinterpret_cast<const char *>(&rec), sizeof(rec));
+    return;
+  }
+
+  static const char line[] = "<Line: ";
+  static const char column[] = ", Column: ";
+  static const char offset[] = ", Offset: ";
+  static const char type[] = ", Type: ";
+  static const char lexeme[] = ", Lexeme: ";
+  this->put(line, sizeof(line) - 1);
+  this->put_uint(t.getLine());
+  this->put(column, sizeof(column) - 1);
+  this->put_uint(t.getColumn());
+  this->put(offset, sizeof(offset) - 1);
+  this->put_uint(t.getOffset());
+  this->put(type, sizeof(type) - 1);
+  const char *name = token_type_name(t.getType());
+  this->put(name, strlen(name));
+  this->put(lexeme, sizeof(lexeme) - 1);
+  const std::string &s = t.getLexeme();
+  this->put(s.data(), s.size());
+  this->put(">\n", 2);
+}
@@ -0,0 +1,117 @@
+#include "scheduler.h"
+#include <algorithm>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+TaskScheduler::TaskScheduler(std::size_t threads)
+    : queued(0), next_queue(0), stopping(false) {
+  if (threads == 0) {
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  for (std::size_t i = 0; i < threads; i++) {
+    this->queues.emplace_back(new Queue());
+  }
+  for (std::size_t i = 0; i < threads; i++) {
+    this->threads.emplace_back(&TaskScheduler::worker, this, i);
+  }
+}
+
+TaskScheduler::~TaskScheduler() {
+  {
+    std::lock_guard<std::mutex> l(this->sleep_lock);
+    this->stopping = true;
+  }
+  this->wakeup.notify_all();
+  for (std::thread &t : this->threads) {
+    t.join();
+  }
+}
+
+bool TaskScheduler::take(std::size_t self, std::function<void()> &task) {
+  std::size_t n = this->queues.size();
+  if (self < n) {
+    Queue &own = *this->queues[self];
+    std::lock_guard<std::mutex> l(own.lock);
+    if (!own.tasks.empty()) {
+      task = std::move(own.tasks.back());
+      own.tasks.pop_back();
+      this->queued--;
+      return true;
+    }
+  }
+
+  // steal, starting with our neighbour so thieves do not all pick the same
+  // victim
+  for (std::size_t i = 1; i <= n; i++) {
+    Queue &victim = *this->queues[(self + i) % n];
+    std::lock_guard<std::mutex> l(victim.lock);
+    if (!victim.tasks.empty()) {
+      task = std::move(victim.tasks.front());
+      victim.tasks.pop_front();
+      this->queued--;
+      return true;
+    }
+  }
+  return false;
+}
+
+void TaskScheduler::worker(std::size_t self) {
+  while (true) {
+    std::function<void()> task;
+    if (this->take(self, task)) {
+      task();
+      continue;
+    }
+
+    std::unique_lock<std::mutex> l(this->sleep_lock);
+    this->wakeup.wait(l, [this] { return this->stopping || this->queued > 0; });
+    if (this->stopping && this->queued == 0) {
+      return;
+    }
+  }
+}
+
+void TaskScheduler::submit(std::function<void()> task) {
+  {
+    // counted before it is published, or a worker could take it and count
+    // it down first. Under the sleep lock, so a worker can not miss it
+    // between checking and going to sleep.
+    std::lock_guard<std::mutex> l(this->sleep_lock);
+    this->queued++;
+  }
+  Queue &q = *this->queues[this->next_queue++ % this->queues.size()];
+  {
+    std::lock_guard<std::mutex> l(q.lock);
+    q.tasks.push_back(std::move(task));
+  }
+  this->wakeup.notify_one();
+}
+
+void TaskScheduler::parallel_for(
+    std::size_t n, const std::function<void(std::size_t)> &task) {
+  std::mutex done_lock;
+  std::condition_variable done;
+  std::size_t remaining = n;
+
+  for (std::size_t i = 0; i < n; i++) {
+    this->submit([&, i] {
+      task(i);
+      std::lock_guard<std::mutex> l(done_lock);
+      if (--remaining == 0) {
+        done.notify_one();
+      }
+    });
+  }
+
+  // help instead of just blocking, this also keeps nested parallel_for
+  // calls from a worker from deadlocking
+  std::function<void()> work;
+  while (this->take(this->queues.size(), work)) {
+    work();
+  }
+
+  std::unique_lock<std::mutex> l(done_lock);
+  done.wait(l, [&] { return remaining == 0; });
+}
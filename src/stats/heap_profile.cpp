@@ -0,0 +1,181 @@
+#include "heap_profile.h"
+#include "stats.h"
+#include <algorithm>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+bool HeapProfile::enabled = false;
+thread_local HeapProfile::Kind HeapProfile::current_kind = HeapProfile::OTHER;
+thread_local std::size_t HeapProfile::current_line = 0;
+
+namespace {
+// a point of the live bytes timeline every this many bytes allocated
+const std::uint64_t SAMPLE_BYTES = 64 * 1024;
+
+struct Block {
+  std::size_t size;
+  HeapProfile::Kind kind;
+  std::size_t line;
+};
+
+struct Totals {
+  std::uint64_t allocations, bytes;
+};
+
+struct Sample {
+  std::uint64_t ns, live;
+};
+
+// Created on enable() and never freed, operator delete can still run after
+// static destructors
+struct State {
+  std::mutex lock;
+  std::unordered_map<void *, Block> live;
+  // by kind and line, see site_key()
+  std::unordered_map<std::uint64_t, Totals> sites;
+  std::uint64_t allocations, bytes, live_bytes, peak;
+  std::uint64_t start, next_sample;
+  std::vector<Sample> timeline;
+};
+State *state = nullptr;
+
+// the profile's own bookkeeping allocates too, which must not be counted
+thread_local bool busy = false;
+
+inline std::uint64_t site_key(HeapProfile::Kind kind, std::size_t line) {
+  return std::uint64_t(kind) << 48 | line;
+}
+inline HeapProfile::Kind site_kind(std::uint64_t key) {
+  return HeapProfile::Kind(key >> 48);
+}
+inline std::size_t site_line(std::uint64_t key) {
+  return key & ((std::uint64_t(1) << 48) - 1);
+}
+
+void print_sites(FILE *out,
+                 std::vector<std::pair<std::uint64_t, Totals>> &sites,
+                 std::size_t top) {
+  std::sort(sites.begin(), sites.end(),
+            [](const std::pair<std::uint64_t, Totals> &a,
+               const std::pair<std::uint64_t, Totals> &b) {
+              return a.second.bytes > b.second.bytes;
+            });
+  fprintf(out, "%8s %8s %12s %14s\n", "kind", "line", "allocs", "bytes");
+  for (std::size_t i = 0; i < sites.size() && i < top; i++) {
+    fprintf(out, "%8s %8zu %12llu %14llu\n",
+            HeapProfile::kind_name(site_kind(sites[i].first)),
+            site_line(sites[i].first),
+            (unsigned long long)sites[i].second.allocations,
+            (unsigned long long)sites[i].second.bytes);
+  }
+}
+} // namespace
+
+void HeapProfile::enable() {
+  busy = true;
+  state = new State();
+  state->allocations = state->bytes = state->live_bytes = state->peak = 0;
+  state->start = Stats::now();
+  state->next_sample = SAMPLE_BYTES;
+  state->timeline.push_back({0, 0});
+  busy = false;
+  enabled = true;
+}
+
+void HeapProfile::note_allocation(void *p, std::size_t size) {
+  if (!enabled || busy) {
+    return;
+  }
+  busy = true;
+  {
+    std::lock_guard<std::mutex> l(state->lock);
+    state->live[p] = {size, current_kind, current_line};
+    Totals &t = state->sites[site_key(current_kind, current_line)];
+    t.allocations++;
+    t.bytes += size;
+
+    state->allocations++;
+    state->bytes += size;
+    state->live_bytes += size;
+    state->peak = std::max(state->peak, state->live_bytes);
+    if (state->bytes >= state->next_sample) {
+      state->timeline.push_back(
+          {Stats::now() - state->start, state->live_bytes});
+      state->next_sample = state->bytes + SAMPLE_BYTES;
+    }
+  }
+  busy = false;
+}
+
+void HeapProfile::note_free(void *p) {
+  if (!enabled || busy || p == nullptr) {
+    return;
+  }
+  busy = true;
+  {
+    std::lock_guard<std::mutex> l(state->lock);
+    auto it = state->live.find(p);
+    // blocks from before enable() were never seen
+    if (it != state->live.end()) {
+      state->live_bytes -= it->second.size;
+      state->live.erase(it);
+    }
+  }
+  busy = false;
+}
+
+const char *HeapProfile::kind_name(Kind k) {
+  static const char *const names[KINDS] = {"other", "token", "string",
+                                           "ast"};
+  return names[k];
+}
+
+void HeapProfile::report(FILE *out, std::size_t top) {
+  if (!enabled) {
+    return;
+  }
+  busy = true;
+  {
+    std::lock_guard<std::mutex> l(state->lock);
+
+    fprintf(out,
+            "heap profile: %llu allocations, %.2f MiB allocated, peak live "
+            "%.2f MiB\n",
+            (unsigned long long)state->allocations,
+            state->bytes / (1024.0 * 1024.0), state->peak / (1024.0 * 1024.0));
+
+    fprintf(out, "\ntop allocation sites:\n");
+    std::vector<std::pair<std::uint64_t, Totals>> sites(state->sites.begin(),
+                                                        state->sites.end());
+    print_sites(out, sites, top);
+
+    // at most 20 rows, evenly spread, plus the current state
+    fprintf(out, "\nlive bytes over time:\n%12s %14s\n", "ms", "live");
+    const std::vector<Sample> &tl = state->timeline;
+    std::size_t step = std::max<std::size_t>(1, tl.size() / 20);
+    for (std::size_t i = 0; i < tl.size(); i += step) {
+      fprintf(out, "%12.3f %14llu\n", tl[i].ns / 1e6,
+              (unsigned long long)tl[i].live);
+    }
+    fprintf(out, "%12.3f %14llu\n", (Stats::now() - state->start) / 1e6,
+            (unsigned long long)state->live_bytes);
+
+    std::unordered_map<std::uint64_t, Totals> leaks;
+    for (const auto &b : state->live) {
+      Totals &t = leaks[site_key(b.second.kind, b.second.line)];
+      t.allocations++;
+      t.bytes += b.second.size;
+    }
+    fprintf(out, "\nstill live: %zu allocations, %llu bytes\n",
+            state->live.size(), (unsigned long long)state->live_bytes);
+    if (!leaks.empty()) {
+      std::vector<std::pair<std::uint64_t, Totals>> sorted(leaks.begin(),
+                                                           leaks.end());
+      print_sites(out, sorted, top);
+    }
+  }
+  busy = false;
+}
@@ -0,0 +1,102 @@
+#include "stats.h"
+#include <cstdlib>
+#include <sys/resource.h>
+
+bool Stats::enabled = false;
+Stats::Counter Stats::phases[Stats::PHASES];
+std::uint64_t Stats::tokens = 0;
+
+namespace {
+// innermost running scope of this thread, null outside any phase
+thread_local Stats::Scope *current = nullptr;
+thread_local Stats::Phase current_phase = Stats::NONE;
+} // namespace
+
+void Stats::enable() { enabled = true; }
+
+Stats::Scope::Scope(Phase phase)
+    : phase(phase), outer(current_phase), parent(nullptr), start(0),
+      nested_ns(0) {
+  if (!Stats::enabled) {
+    return;
+  }
+  this->parent = current;
+  current = this;
+  current_phase = phase;
+  Stats::phases[phase].ran = true;
+  this->start = Stats::now();
+}
+
+Stats::Scope::~Scope() {
+  if (!Stats::enabled) {
+    return;
+  }
+  std::uint64_t elapsed = Stats::now() - this->start;
+  Stats::phases[this->phase].ns += elapsed - this->nested_ns;
+  if (this->parent) {
+    this->parent->nested_ns += elapsed;
+  }
+  current = this->parent;
+  current_phase = this->outer;
+}
+
+void Stats::note_allocation(std::size_t size) {
+  if (!enabled || current == nullptr) {
+    return;
+  }
+  phases[current_phase].bytes += size;
+  phases[current_phase].allocations++;
+}
+
+const char *Stats::phase_name(Phase p) {
+  static const char *const names[PHASES] = {
+      "other", "read", "lex", "parse", "resolve", "compile", "execute",
+      "output"};
+  return names[p];
+}
+
+void Stats::report(FILE *out, bool json) {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  // ru_maxrss is in KiB on Linux
+  unsigned long long peak_rss = (unsigned long long)usage.ru_maxrss * 1024;
+
+  double lex_s = phases[READ].ns / 1e9 + phases[LEX].ns / 1e9;
+  double tokens_per_s = lex_s > 0 ? tokens / lex_s : 0;
+
+  if (json) {
+    fprintf(out, "{\"phases\": {");
+    bool first = true;
+    for (int p = READ; p < PHASES; p++) {
+      if (!phases[p].ran) {
+        continue;
+      }
+      fprintf(out,
+              "%s\"%s\": {\"ms\": %.3f, \"bytes\": %llu, \"allocations\": "
+              "%llu}",
+              first ? "" : ", ", phase_name(Phase(p)), phases[p].ns / 1e6,
+              (unsigned long long)phases[p].bytes,
+              (unsigned long long)phases[p].allocations);
+      first = false;
+    }
+    fprintf(out,
+            "}, \"tokens\": %llu, \"tokens_per_second\": %.0f, "
+            "\"peak_rss_bytes\": %llu}\n",
+            (unsigned long long)tokens, tokens_per_s, peak_rss);
+    return;
+  }
+
+  fprintf(out, "%-8s %12s %14s %12s\n", "phase", "ms", "bytes", "allocs");
+  for (int p = READ; p < PHASES; p++) {
+    if (!phases[p].ran) {
+      fprintf(out, "%-8s %12s\n", phase_name(Phase(p)), "not run");
+      continue;
+    }
+    fprintf(out, "%-8s %12.3f %14llu %12llu\n", phase_name(Phase(p)),
+            phases[p].ns / 1e6, (unsigned long long)phases[p].bytes,
+            (unsigned long long)phases[p].allocations);
+  }
+  fprintf(out, "tokens: %llu (%.0f tokens/s)\n", (unsigned long long)tokens,
+          tokens_per_s);
+  fprintf(out, "peak rss: %.2f MiB\n", peak_rss / (1024.0 * 1024.0));
+}
@@ -0,0 +1,18 @@
+#pragma once
+#ifndef __CHECK_H__
+#define __CHECK_H__
+
+#include <cstdio>
+#include <cstdlib>
+
+// Fail the test with the condition and where it is, like assert() but
+// also in release builds
+#define CHECK(cond)                                                            \
+  do {                                                                         \
+    if (!(cond)) {                                                             \
+      fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+      exit(EXIT_FAILURE);                                                      \
+    }                                                                          \
+  } while (0)
+
+#endif
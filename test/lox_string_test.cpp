@@ -0,0 +1,212 @@
+// LoxString against std::string: the inline/heap boundary, in-place
+// appends on shared nodes, concat chains, prepend-deep ropes, indexing,
+// equality and hashing across representations, and copies and moves made
+// before and after a rope is flattened. Then random operations on a pool
+// of pairs. Leaks and use after free show up under -fsanitize=address.
+
+#include "check.h"
+#include "lox_string.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+static void check_same(const LoxString &s, const string &want) {
+  CHECK(s.size() == want.size());
+  CHECK(s.empty() == want.empty());
+  // indexing goes first, it has to flatten a rope by itself
+  for (size_t i = 0; i < want.size(); i += 1 + want.size() / 64) {
+    CHECK(s[i] == want[i]);
+  }
+  if (!want.empty()) {
+    CHECK(s[want.size() - 1] == want.back());
+  }
+  CHECK(!s.is_rope());
+  CHECK(s.str() == want);
+  CHECK(s == LoxString(want));
+  CHECK(s.hash() == LoxString(want).hash());
+}
+
+static string text(size_t n, char first) {
+  string s;
+  for (size_t i = 0; i < n; i++) {
+    s += char(first + i % 23);
+  }
+  return s;
+}
+
+// Every split of lengths around the inline size and the rope threshold
+static void check_boundaries() {
+  const size_t sizes[] = {0, 1, 7, 14, 15, 16, 17, 30, 31, 128, 255, 256, 300};
+  for (size_t a : sizes) {
+    for (size_t b : sizes) {
+      string x = text(a, 'a'), y = text(b, 'A');
+      LoxString s = LoxString(x) + LoxString(y);
+      check_same(s, x + y);
+    }
+  }
+}
+
+// s = s + x in a loop appends in place, older handles on the same node
+// must keep seeing their own prefix
+static void check_concat_chain() {
+  LoxString s;
+  string want;
+  vector<pair<LoxString, string>> snapshots;
+  for (size_t i = 0; i < 3000; i++) {
+    string piece = text(1 + i % 40, char('a' + i % 26));
+    s = s + LoxString(piece);
+    want += piece;
+    if (i % 97 == 0) {
+      snapshots.emplace_back(s, want);
+    }
+  }
+  check_same(s, want);
+  for (auto &snap : snapshots) {
+    check_same(snap.first, snap.second);
+    // appending to an older prefix must copy, not overwrite s
+    LoxString fork = snap.first + LoxString("#fork#");
+    check_same(fork, snap.second + "#fork#");
+  }
+  check_same(s, want);
+}
+
+// x + s over and over nests the rope one level per step, flattening and
+// releasing it must not recurse
+static void check_prepend_rope() {
+  const string piece = text(300, 'k');
+  LoxString s(piece);
+  for (size_t i = 0; i < 100000; i++) {
+    s = LoxString(piece) + s;
+  }
+  CHECK(s.is_rope());
+  CHECK(s.size() == piece.size() * 100001);
+  for (size_t i = 0; i < s.size(); i += 7919) {
+    CHECK(s[i] == piece[i % piece.size()]);
+  }
+
+  string small_want;
+  LoxString small;
+  for (size_t i = 0; i < 2000; i++) {
+    string p = to_string(i) + ",";
+    small = LoxString(p) + small;
+    small_want = p + small_want;
+  }
+  check_same(small, small_want);
+}
+
+static void check_copy_move_flatten() {
+  string x = text(600, 'a'), y = text(2000, 'b');
+  LoxString rope = LoxString(x) + LoxString(y);
+  CHECK(rope.is_rope());
+
+  // copies share the node, flattening through one flattens all of them
+  LoxString before(rope);
+  CHECK(before.is_rope());
+  CHECK(rope.data() != nullptr);
+  CHECK(!before.is_rope());
+  check_same(before, x + y);
+
+  LoxString after = rope;
+  LoxString moved(std::move(after));
+  CHECK(after.empty());
+  check_same(after, "");
+  check_same(moved, x + y);
+
+  LoxString assigned;
+  assigned = std::move(moved);
+  CHECK(moved.empty());
+  check_same(assigned, x + y);
+  LoxString &self = assigned;
+  assigned = self;
+  check_same(assigned, x + y);
+  assigned = LoxString("short");
+  check_same(assigned, "short");
+  check_same(rope, x + y);
+
+  // equal text in different representations
+  LoxString flat(x + y);
+  LoxString other = LoxString(x.substr(0, 100)) + LoxString(x.substr(100)) +
+                    LoxString(y);
+  CHECK(flat == rope && rope == other && other == flat);
+  CHECK(flat.hash() == other.hash());
+  CHECK(LoxString(x) != LoxString(y));
+  CHECK(LoxString(x) != LoxString(x + "!"));
+}
+
+// Random operations on a pool of LoxString / std::string pairs
+static void check_random() {
+  uint64_t state = 42;
+  auto next = [&](uint32_t n) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return uint32_t(state >> 16) % n;
+  };
+
+  const size_t POOL = 16;
+  vector<LoxString> lox(POOL);
+  vector<string> want(POOL);
+  for (size_t step = 0; step < 20000; step++) {
+    size_t a = next(POOL), b = next(POOL);
+    switch (next(8)) {
+    case 0: {
+      // a length from every size class
+      static const uint32_t lengths[] = {3, 16, 200, 2000};
+      string s = text(next(lengths[next(4)]), char('a' + next(26)));
+      lox[a] = LoxString(s);
+      want[a] = s;
+      break;
+    }
+    case 1:
+      lox[a] = lox[a] + lox[b];
+      want[a] = want[a] + want[b];
+      break;
+    case 2:
+      lox[a] = lox[b] + lox[a];
+      want[a] = want[b] + want[a];
+      break;
+    case 3:
+      lox[a] = lox[b];
+      want[a] = want[b];
+      break;
+    case 4:
+      lox[a] = std::move(lox[b]);
+      want[a] = std::move(want[b]);
+      lox[b] = LoxString();
+      want[b].clear();
+      break;
+    case 5:
+      if (!want[a].empty()) {
+        size_t i = next(uint32_t(want[a].size()));
+        CHECK(lox[a][i] == want[a][i]);
+      }
+      break;
+    case 6:
+      CHECK((lox[a] == lox[b]) == (want[a] == want[b]));
+      break;
+    default:
+      // keep the strings from growing without bound
+      if (want[a].size() > 100000) {
+        lox[a] = LoxString();
+        want[a].clear();
+      }
+      break;
+    }
+  }
+  for (size_t i = 0; i < POOL; i++) {
+    check_same(lox[i], want[i]);
+  }
+}
+
+int main() {
+  check_boundaries();
+  check_concat_chain();
+  check_prepend_rope();
+  check_copy_move_flatten();
+  check_random();
+  return 0;
+}
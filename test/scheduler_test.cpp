@@ -0,0 +1,81 @@
+// TaskScheduler against a serial loop, with 1 to 8 workers, nested
+// parallel_for calls from inside tasks and a flood of submit() calls that
+// the destructor has to drain. Meant to be run under -fsanitize=thread as
+// well.
+
+#include "check.h"
+#include "scheduler.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+using namespace std;
+
+// Uneven work, so that stealing actually happens
+static uint64_t work(size_t i) {
+  uint64_t h = i * 0x9e3779b97f4a7c15ULL + 1;
+  for (size_t k = 0; k < (i % 7) * 50; k++) {
+    h ^= h << 13;
+    h ^= h >> 7;
+    h ^= h << 17;
+  }
+  return h;
+}
+
+static void check_parallel_for(size_t threads) {
+  const size_t n = 5000;
+  vector<uint64_t> serial(n), parallel(n, 0);
+  for (size_t i = 0; i < n; i++) {
+    serial[i] = work(i);
+  }
+
+  TaskScheduler pool(threads);
+  CHECK(pool.size() == threads);
+  pool.parallel_for(n, [&](size_t i) { parallel[i] = work(i); });
+  CHECK(parallel == serial);
+
+  // nothing to do returns right away
+  pool.parallel_for(0, [&](size_t) { CHECK(false); });
+}
+
+static void check_nested(size_t threads) {
+  const size_t outer = 16, inner = 200;
+  vector<uint64_t> results(outer * inner, 0);
+
+  TaskScheduler pool(threads);
+  pool.parallel_for(outer, [&](size_t i) {
+    pool.parallel_for(inner, [&](size_t j) {
+      results[i * inner + j] = work(i * inner + j);
+    });
+    // the inner loop is complete before the outer task returns
+    for (size_t j = 0; j < inner; j++) {
+      CHECK(results[i * inner + j] == work(i * inner + j));
+    }
+  });
+  for (size_t i = 0; i < results.size(); i++) {
+    CHECK(results[i] == work(i));
+  }
+}
+
+static void check_submit_drains(size_t threads) {
+  const size_t n = 20000;
+  atomic<size_t> ran(0);
+  {
+    TaskScheduler pool(threads);
+    for (size_t i = 0; i < n; i++) {
+      pool.submit([&] { ran++; });
+    }
+  }
+  CHECK(ran == n);
+}
+
+int main() {
+  const size_t threads[] = {1, 2, 4, 8};
+  for (size_t t : threads) {
+    check_parallel_for(t);
+    check_nested(t);
+    check_submit_drains(t);
+  }
+  return 0;
+}
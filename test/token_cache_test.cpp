@@ -0,0 +1,154 @@
+// TokenCache round trip against a fresh scan, and caches that must be
+// rejected: stale, truncated, and crafted headers that carry a valid
+// checksum but sizes that only add up once they wrap around.
+
+#include "check.h"
+#include "scanner.h"
+#include "token.h"
+#include "token_cache.h"
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+using namespace std;
+
+static void write_file(const string &path, const string &data) {
+  int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  CHECK(fd != -1);
+  CHECK(write(fd, data.data(), data.size()) == ssize_t(data.size()));
+  close(fd);
+}
+
+static string read_file(const string &path) {
+  FILE *fp = fopen(path.c_str(), "rb");
+  CHECK(fp != nullptr);
+  string data;
+  char buf[4096];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), fp)) > 0) {
+    data.append(buf, n);
+  }
+  fclose(fp);
+  return data;
+}
+
+static vector<Token> scan(const string &path) {
+  Scanner sc(path);
+  vector<Token> tokens;
+  while (true) {
+    tokens.push_back(sc.take_token());
+    if (tokens.back().getType() == tok_eof) {
+      return tokens;
+    }
+  }
+}
+
+static void store(const string &path) {
+  uint64_t hash, size;
+  CHECK(TokenCache::source_key(path, hash, size));
+  CHECK(TokenCache::store(path, hash, size, scan(path)));
+}
+
+static uint64_t align8(uint64_t n) { return (n + 7) & ~uint64_t(7); }
+
+// Where the chars section starts for the counts in h, as the file lays it
+// out
+static uint64_t chars_at(const TokenCache::LoxcHeader &h) {
+  uint64_t tokens_at = align8(sizeof(h));
+  uint64_t strings_at =
+      align8(tokens_at + sizeof(TokenCache::LoxcToken) * h.token_count);
+  return align8(strings_at + sizeof(TokenCache::LoxcString) * h.string_count);
+}
+
+// Rewrite the header of the cache, with a checksum that matches again
+static void patch_header(const string &path,
+                         void (*patch)(TokenCache::LoxcHeader &)) {
+  string cache = read_file(TokenCache::cache_path(path));
+  TokenCache::LoxcHeader header;
+  memcpy(&header, cache.data(), sizeof(header));
+  patch(header);
+  size_t tokens_at = align8(sizeof(header));
+  header.checksum =
+      TokenCache::hash(cache.data() + tokens_at, cache.size() - tokens_at);
+  memcpy(&cache[0], &header, sizeof(header));
+  write_file(TokenCache::cache_path(path), cache);
+}
+
+static void check_round_trip(const string &path) {
+  store(path);
+  vector<Token> want = scan(path), got;
+  CHECK(TokenCache::load(path, got));
+  CHECK(got.size() == want.size());
+  for (size_t i = 0; i < want.size(); i++) {
+    CHECK(got[i].getType() == want[i].getType());
+    CHECK(got[i].getLexeme() == want[i].getLexeme());
+    CHECK(got[i].getLine() == want[i].getLine());
+    CHECK(got[i].getColumn() == want[i].getColumn());
+    CHECK(got[i].getOffset() == want[i].getOffset());
+    CHECK(got[i].getNumber() == want[i].getNumber());
+  }
+}
+
+int main() {
+  char dir[] = "/tmp/cpplox_test_XXXXXX";
+  CHECK(mkdtemp(dir) != nullptr);
+  string path = string(dir) + "/script.lox";
+  string source = "var answer = 42.5;\n"
+                  "func f(a, b) { return a * b + answer; }\n"
+                  "print \"hi\" + \"hi\";\n";
+  write_file(path, source);
+
+  check_round_trip(path);
+  {
+    TokenCache::View view(path);
+    CHECK(view.ok());
+    CHECK(view.size() == scan(path).size());
+  }
+
+  // an edited script misses
+  write_file(path, source + "print answer;\n");
+  {
+    TokenCache::View view(path);
+    CHECK(!view.ok());
+  }
+  check_round_trip(path);
+
+  // a truncated cache misses
+  string cache = read_file(TokenCache::cache_path(path));
+  write_file(TokenCache::cache_path(path), cache.substr(0, cache.size() - 1));
+  {
+    TokenCache::View view(path);
+    CHECK(!view.ok());
+  }
+
+  // String table past the end of the file, with a chars_size that wraps
+  // the section sum around to exactly the file size
+  store(path);
+  patch_header(path, [](TokenCache::LoxcHeader &h) {
+    uint64_t file_size = chars_at(h) + h.chars_size;
+    h.string_count += 1000000;
+    h.chars_size = file_size - chars_at(h);
+  });
+  {
+    TokenCache::View view(path);
+    CHECK(!view.ok());
+  }
+
+  // the untouched header still loads, so the patch itself is not the
+  // reason it was rejected
+  store(path);
+  patch_header(path, [](TokenCache::LoxcHeader &) {});
+  {
+    TokenCache::View view(path);
+    CHECK(view.ok());
+  }
+
+  unlink(TokenCache::cache_path(path).c_str());
+  unlink(path.c_str());
+  rmdir(dir);
+  return 0;
+}
@@ -0,0 +1,130 @@
+// TokenPipeline::next_token against Scanner::take_token on the same
+// input, with queues small enough that both sides keep blocking on each
+// other. Then pipelines destroyed before EOF: with the producer blocked on
+// a full queue, and with it waiting on a pipe whose writer never closes.
+// A destructor that hangs fails the test through the alarm.
+
+#include "check.h"
+#include "scanner.h"
+#include "token.h"
+#include "token_pipeline.h"
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <unistd.h>
+
+using namespace std;
+
+static bool same(const Token &a, const Token &b) {
+  return a.getType() == b.getType() && a.getLine() == b.getLine() &&
+         a.getColumn() == b.getColumn() && a.getOffset() == b.getOffset() &&
+         a.getLexeme() == b.getLexeme();
+}
+
+// Deterministic source of about size bytes, from snippets that cover every
+// kind of token and a few errors
+static string generate(size_t size, uint32_t seed) {
+  static const char *const snippets[] = {
+      "var a = 1;\n",        "func f(x, y) { return x * y; }\n",
+      "print \"hi\\n\";\n",  "if (a >= 2.5 and b != nil) a = a - 1;\n",
+      "// comment\n",       "class C < B { get() { return this.v; } }\n",
+      "list l = [1, 2];\n", "x = -0.125e3 / (y + 7);\n",
+      "while (!done) {}\n", "@\n",
+      "\"unterminated\n",   "\t  \r\n"};
+  const size_t count = sizeof(snippets) / sizeof(snippets[0]);
+  uint64_t state = seed * 0x9e3779b97f4a7c15ULL + 1;
+  string s;
+  while (s.size() < size) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    s += snippets[(state >> 16) % count];
+  }
+  return s;
+}
+
+static string write_temp(const string &src) {
+  char path[] = "/tmp/cpplox_test_XXXXXX";
+  int fd = mkstemp(path);
+  CHECK(fd != -1);
+  CHECK(write(fd, src.data(), src.size()) == ssize_t(src.size()));
+  close(fd);
+  return path;
+}
+
+static void check_same_tokens(const string &src, size_t capacity) {
+  string path = write_temp(src);
+  {
+    Scanner sc(path);
+    TokenPipeline pipeline(path, capacity);
+    while (true) {
+      Token want = sc.take_token();
+      Token got = pipeline.next_token();
+      CHECK(same(want, got));
+      if (want.getType() == tok_eof) {
+        break;
+      }
+    }
+    // EOF again on every call after the end
+    CHECK(pipeline.next_token().getType() == tok_eof);
+    CHECK(pipeline.next_token().getType() == tok_eof);
+  }
+  unlink(path.c_str());
+}
+
+// The producer fills the queue and sleeps on it, nobody drains it
+static void check_cancel_full_queue(size_t consumed) {
+  string path = write_temp(generate(1 << 16, 7));
+  {
+    Scanner sc(path);
+    TokenPipeline pipeline(path, 4);
+    for (size_t i = 0; i < consumed; i++) {
+      CHECK(same(sc.take_token(), pipeline.next_token()));
+    }
+    // long enough for the producer to give up spinning and sleep
+    usleep(20000);
+  }
+  unlink(path.c_str());
+}
+
+// The producer waits for input on a pipe that stays open. With a small
+// queue it may also be blocked on the queue first.
+static void check_cancel_open_pipe(size_t capacity) {
+  int fds[2];
+  CHECK(pipe(fds) == 0);
+  string src = generate(4096, 3);
+  CHECK(write(fds[1], src.data(), src.size()) == ssize_t(src.size()));
+  {
+    TokenPipeline pipeline("/dev/fd/" + to_string(fds[0]), capacity);
+    Scanner sc(src.data(), src.size());
+    // the last token may still change with more input, stay short of it
+    for (size_t i = 0; i < 100; i++) {
+      CHECK(same(sc.take_token(), pipeline.next_token()));
+    }
+    usleep(20000);
+  }
+  close(fds[0]);
+  close(fds[1]);
+}
+
+int main() {
+  // a destructor that never returns fails instead of hanging ctest
+  alarm(60);
+
+  const size_t capacities[] = {1, 3, 4096};
+  for (size_t capacity : capacities) {
+    check_same_tokens("", capacity);
+    check_same_tokens("var", capacity);
+    check_same_tokens("print \"no newline at the end\"", capacity);
+    for (uint32_t seed = 1; seed <= 4; seed++) {
+      check_same_tokens(generate(seed * 50000, seed), capacity);
+    }
+  }
+
+  check_cancel_full_queue(0);
+  check_cancel_full_queue(10);
+  check_cancel_open_pipe(4);
+  check_cancel_open_pipe(4096);
+  return 0;
+}